@@ -0,0 +1,157 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Per-query Dijkstra grown from both ends at once: forward from the origin over the
+// outgoing edges, backward from the destination over the incoming ones. It stops as soon
+// as the two queue minimums together reach the best meeting weight found so far.
+template <typename Weight>
+class BidirectionalDijkstraRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit BidirectionalDijkstraRouter(const Graph& graph);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // One direction of the search
+    struct Search {
+        explicit Search(size_t vertex_count)
+            : weights(vertex_count)
+            , prev_edges(vertex_count) {
+        }
+
+        std::vector<std::optional<Weight>> weights;
+        //forward: the edge the vertex was reached by, backward: the edge leaving it towards the target
+        std::vector<std::optional<EdgeId>> prev_edges;
+        PriorityQueue queue;
+    };
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+};
+
+template <typename Weight>
+BidirectionalDijkstraRouter<Weight>::BidirectionalDijkstraRouter(const Graph& graph)
+    : graph_(graph)
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename BidirectionalDijkstraRouter<Weight>::RouteInfo>
+BidirectionalDijkstraRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    Search forward(vertex_count);
+    Search backward(vertex_count);
+    forward.weights[from] = ZERO_WEIGHT;
+    forward.queue.push({ZERO_WEIGHT, from});
+    backward.weights[to] = ZERO_WEIGHT;
+    backward.queue.push({ZERO_WEIGHT, to});
+
+    std::optional<Weight> best_weight;
+    if (from == to) {
+        best_weight = ZERO_WEIGHT;
+    }
+    VertexId meeting_vertex = from;
+
+    auto pop_settled = [](Search& search) {
+        while (!search.queue.empty() && search.queue.top().weight > *search.weights[search.queue.top().vertex]) {
+            search.queue.pop();
+        }
+    };
+
+    while (true) {
+        pop_settled(forward);
+        pop_settled(backward);
+        if (forward.queue.empty() || backward.queue.empty()) {
+            break;
+        }
+        //standard stopping criterion: no path through unsettled vertexes can be lighter
+        if (best_weight && !(forward.queue.top().weight + backward.queue.top().weight < *best_weight)) {
+            break;
+        }
+
+        const bool is_forward = !(backward.queue.top().weight < forward.queue.top().weight);
+        Search& search = is_forward ? forward : backward;
+        const Search& other = is_forward ? backward : forward;
+        const auto [weight, vertex] = search.queue.top();
+        search.queue.pop();
+
+        auto relax = [&, weight = weight](const IncidentEdge<Weight>& arc) {
+            const VertexId next = arc.vertex;
+            const Weight candidate_weight = weight + arc.weight;
+            if (auto& relaxing = search.weights[next]; !relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                search.prev_edges[next] = arc.edge_id;
+                search.queue.push({candidate_weight, next});
+                if (const auto& other_weight = other.weights[next]) {
+                    if (!best_weight || candidate_weight + *other_weight < *best_weight) {
+                        best_weight = candidate_weight + *other_weight;
+                        meeting_vertex = next;
+                    }
+                }
+            }
+        };
+        for (const auto& arc : is_forward ? graph_.GetIncidentArcs(vertex) : graph_.GetIncomingArcs(vertex)) {
+            relax(arc);
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    //origin -> meeting vertex, then meeting vertex -> destination
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = forward.prev_edges[meeting_vertex];
+         edge_id;
+         edge_id = forward.prev_edges[graph_.GetEdge(*edge_id).from])
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    for (std::optional<EdgeId> edge_id = backward.prev_edges[meeting_vertex];
+         edge_id;
+         edge_id = backward.prev_edges[graph_.GetEdge(*edge_id).to])
+    {
+        edges.push_back(*edge_id);
+    }
+
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Same all-pairs table as Router, stored as two contiguous V x V arrays (weights and
+// predecessor edges) with sentinels instead of optionals and 32-bit edge ids.
+// TableWeight = float halves the weight array at the cost of float rounding
+// in the reported total weight.
+template <typename Weight, typename TableWeight = Weight>
+class CompactRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using CompactEdgeId = std::uint32_t;
+
+    explicit CompactRouter(const Graph& graph, size_t thread_count = 1);
+    // Answers from a table built earlier (e.g. mapped from a file) in place, without a copy;
+    // the table has to outlive the router. It is not hashed, so every predecessor edge is
+    // checked as the route is walked back and a chain not leading to from means no route
+    CompactRouter(const Graph& graph, const TableWeight* weights, const CompactEdgeId* prev_edges);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    //V x V row-major arrays, INFINITE_WEIGHT and NO_EDGE where there is no route
+    const TableWeight* GetWeights() const;
+    const CompactEdgeId* GetPrevEdges() const;
+    //bytes of the table for a graph of vertex_count vertexes
+    static size_t EstimateMemoryUsage(size_t vertex_count);
+
+    static constexpr TableWeight INFINITE_WEIGHT = std::numeric_limits<TableWeight>::has_infinity
+                                                 ? std::numeric_limits<TableWeight>::infinity()
+                                                 : std::numeric_limits<TableWeight>::max();
+    static constexpr CompactEdgeId NO_EDGE = std::numeric_limits<CompactEdgeId>::max();
+
+private:
+    size_t GetCellIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
+    void InitializeRoutesInternalData() {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[GetCellIndex(vertex, vertex)] = ZERO_WEIGHT;
+            for (const auto& arc : graph_.GetIncidentArcs(vertex)) {
+                if (arc.weight < Weight{}) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+                const size_t cell = GetCellIndex(vertex, arc.vertex);
+                const auto edge_weight = static_cast<TableWeight>(arc.weight);
+                if (weights_[cell] > edge_weight) {
+                    weights_[cell] = edge_weight;
+                    prev_edges_[cell] = static_cast<CompactEdgeId>(arc.edge_id);
+                }
+            }
+        }
+    }
+
+    // Mirrors Router::RelaxRoutesInternalDataThroughVertex, so ties are resolved the same way
+    void RelaxRoutesInternalDataThroughVertex(VertexId vertex_from_first, VertexId vertex_from_last,
+                                              VertexId vertex_through) {
+        const TableWeight* row_through = weights_.data() + GetCellIndex(vertex_through, 0);
+        const CompactEdgeId* prev_row_through = prev_edges_.data() + GetCellIndex(vertex_through, 0);
+
+        for (VertexId vertex_from = vertex_from_first; vertex_from < vertex_from_last; ++vertex_from) {
+            const size_t cell_from = GetCellIndex(vertex_from, vertex_through);
+            const TableWeight weight_from = weights_[cell_from];
+            if (weight_from == INFINITE_WEIGHT) {
+                continue;
+            }
+            const CompactEdgeId prev_edge_from = prev_edges_[cell_from];
+            TableWeight* row_from = weights_.data() + GetCellIndex(vertex_from, 0);
+            CompactEdgeId* prev_row_from = prev_edges_.data() + GetCellIndex(vertex_from, 0);
+
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                if (row_through[vertex_to] == INFINITE_WEIGHT) {
+                    continue;
+                }
+                const TableWeight candidate_weight = weight_from + row_through[vertex_to];
+                if (candidate_weight < row_from[vertex_to]) {
+                    row_from[vertex_to] = candidate_weight;
+                    prev_row_from[vertex_to] = prev_row_through[vertex_to] != NO_EDGE
+                                             ? prev_row_through[vertex_to] : prev_edge_from;
+                }
+            }
+        }
+    }
+
+    void RelaxRoutesInternalData(size_t thread_count) {
+        thread_count = std::max<size_t>(1, std::min(thread_count, vertex_count_));
+        parallel::Barrier barrier(thread_count);
+        parallel::ForEachWorker(thread_count, [&](size_t worker, size_t worker_count) {
+            const auto [first, last] = parallel::GetChunk(vertex_count_, worker, worker_count);
+            for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+                RelaxRoutesInternalDataThroughVertex(first, last, vertex_through);
+                if (worker_count > 1) {
+                    barrier.ArriveAndWait();
+                }
+            }
+        });
+    }
+
+    static constexpr TableWeight ZERO_WEIGHT{};
+
+    const Graph& graph_;
+    const size_t vertex_count_;
+    std::vector<TableWeight> weights_;
+    std::vector<CompactEdgeId> prev_edges_;
+    //the table answered from: the arrays above or the one given to the constructor
+    const TableWeight* weights_data_ = nullptr;
+    const CompactEdgeId* prev_edges_data_ = nullptr;
+};
+
+template <typename Weight, typename TableWeight>
+CompactRouter<Weight, TableWeight>::CompactRouter(const Graph& graph, size_t thread_count)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    if (graph.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for the compact router table");
+    }
+    weights_.assign(vertex_count_ * vertex_count_, INFINITE_WEIGHT);
+    prev_edges_.assign(vertex_count_ * vertex_count_, NO_EDGE);
+
+    InitializeRoutesInternalData();
+    RelaxRoutesInternalData(parallel::ResolveWorkerCount(thread_count));
+    weights_data_ = weights_.data();
+    prev_edges_data_ = prev_edges_.data();
+}
+
+template <typename Weight, typename TableWeight>
+CompactRouter<Weight, TableWeight>::CompactRouter(const Graph& graph, const TableWeight* weights,
+                                                  const CompactEdgeId* prev_edges)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , weights_data_(weights)
+    , prev_edges_data_(prev_edges)
+{
+}
+
+template <typename Weight, typename TableWeight>
+const TableWeight* CompactRouter<Weight, TableWeight>::GetWeights() const {
+    return weights_data_;
+}
+
+template <typename Weight, typename TableWeight>
+const typename CompactRouter<Weight, TableWeight>::CompactEdgeId* CompactRouter<Weight, TableWeight>::GetPrevEdges() const {
+    return prev_edges_data_;
+}
+
+template <typename Weight, typename TableWeight>
+size_t CompactRouter<Weight, TableWeight>::EstimateMemoryUsage(size_t vertex_count) {
+    return vertex_count * vertex_count * (sizeof(TableWeight) + sizeof(CompactEdgeId));
+}
+
+template <typename Weight, typename TableWeight>
+std::optional<typename CompactRouter<Weight, TableWeight>::RouteInfo>
+CompactRouter<Weight, TableWeight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const size_t cell = GetCellIndex(from, to);
+    if (weights_data_[cell] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    const CompactEdgeId* prev_row = prev_edges_data_ + GetCellIndex(from, 0);
+    VertexId vertex = to;
+    for (CompactEdgeId edge_id = prev_row[to]; edge_id != NO_EDGE; edge_id = prev_row[vertex]) {
+        //a shortest path visits every vertex once at most
+        if (edge_id >= graph_.GetEdgeCount() || graph_.GetEdge(edge_id).to != vertex || edges.size() == vertex_count_) {
+            return std::nullopt;
+        }
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    if (vertex != from) {
+        return std::nullopt;
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{static_cast<Weight>(weights_data_[cell]), std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,478 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction Hierarchies: the constructor contracts the vertices one by one (cheapest
+// first, by edge difference) and adds shortcut edges that preserve shortest paths
+// among the remaining vertices. A query is a bidirectional Dijkstra that only climbs
+// the hierarchy; the shortcuts of the found path are unpacked back into the graph's EdgeIds.
+template <typename Weight>
+class ContractionHierarchyRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit ContractionHierarchyRouter(const Graph& graph);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    size_t GetShortcutCount() const;
+
+private:
+    // Edges [0, graph.GetEdgeCount()) are the graph's own edges under the same ids,
+    // the rest are shortcuts replacing two consecutive hierarchy edges
+    struct HierarchyEdge {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        size_t first_child;
+        size_t second_child;
+    };
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+    //a hierarchy edge as seen from the vertex searched from, edge_id is its index in edges_
+    using Arc = IncidentEdge<Weight>;
+    using ArcsRange = ranges::Range<const Arc*>;
+
+    // Adjacency and scratch data that only live while the hierarchy is being built.
+    // Contracted vertices are only flagged: the edges leading to them are skipped by the
+    // searches and dropped from a list the next time its vertex is examined
+    struct ContractionState {
+        std::vector<std::vector<size_t>> out_edges;
+        std::vector<std::vector<size_t>> in_edges;
+        std::vector<bool> is_contracted;
+        std::vector<int> contracted_neighbors;
+        //set when a neighbour is contracted, the priority in the queue is recomputed before use
+        std::vector<bool> is_stale;
+        //position of a neighbour in the list being collected, NO_CHILD when absent
+        std::vector<size_t> neighbor_edges;
+        //witness search scratch, reset through touched
+        std::vector<std::optional<Weight>> witness_weights;
+        std::vector<size_t> witness_hops;
+        std::vector<VertexId> touched;
+    };
+
+    struct Shortcut {
+        size_t first_edge;
+        size_t second_edge;
+    };
+
+    void AddHierarchyEdge(ContractionState& state, HierarchyEdge edge);
+    void DropContractedEdges(ContractionState& state, VertexId vertex) const;
+    void RunWitnessSearch(ContractionState& state, VertexId source, VertexId excluded, Weight max_weight,
+                          size_t hop_limit) const;
+    std::vector<Shortcut> FindShortcuts(ContractionState& state, VertexId vertex, size_t hop_limit) const;
+    int GetContractionPriority(ContractionState& state, VertexId vertex) const;
+    void ContractVertex(ContractionState& state, VertexId vertex);
+    void ContractGraph();
+    void PackSearchArcs();
+    ArcsRange GetSearchArcs(size_t side, VertexId vertex) const;
+    void UnpackEdge(size_t hierarchy_edge, std::vector<EdgeId>& edges) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr size_t NO_CHILD = std::numeric_limits<size_t>::max();
+    //witness searches give up (and keep the shortcut) after settling this many vertices
+    //or on paths of more edges than the hop limit. Priorities are only estimates, so they
+    //look for direct edges alone; the contraction itself searches further
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 50;
+    static constexpr size_t PRIORITY_HOP_LIMIT = 1;
+    static constexpr size_t CONTRACTION_HOP_LIMIT = 5;
+
+    const Graph& graph_;
+    std::vector<HierarchyEdge> edges_;
+    std::vector<size_t> rank_;
+    //side 0: the edges climbing from a vertex to their heads, side 1: the edges descending
+    //into a vertex from their tails (scanned backwards). Packed like a frozen graph
+    std::vector<size_t> search_offsets_[2];
+    std::vector<Arc> search_arcs_[2];
+};
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph)
+    : graph_(graph)
+    , rank_(graph.GetVertexCount())
+{
+    edges_.reserve(graph.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        edges_.push_back({edge.from, edge.to, edge.weight, NO_CHILD, NO_CHILD});
+    }
+
+    ContractGraph();
+    PackSearchArcs();
+}
+
+template <typename Weight>
+size_t ContractionHierarchyRouter<Weight>::GetShortcutCount() const {
+    return edges_.size() - graph_.GetEdgeCount();
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::AddHierarchyEdge(ContractionState& state, HierarchyEdge edge) {
+    edges_.push_back(edge);
+    state.out_edges[edge.from].push_back(edges_.size() - 1);
+    state.in_edges[edge.to].push_back(edges_.size() - 1);
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::DropContractedEdges(ContractionState& state, VertexId vertex) const {
+    auto drop = [&](std::vector<size_t>& edge_indexes, auto get_neighbor) {
+        edge_indexes.erase(std::remove_if(edge_indexes.begin(), edge_indexes.end(), [&](size_t edge_index) {
+            return state.is_contracted[get_neighbor(edges_[edge_index])];
+        }), edge_indexes.end());
+    };
+    drop(state.in_edges[vertex], [](const HierarchyEdge& edge) { return edge.from; });
+    drop(state.out_edges[vertex], [](const HierarchyEdge& edge) { return edge.to; });
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::RunWitnessSearch(ContractionState& state, VertexId source,
+                                                          VertexId excluded, Weight max_weight,
+                                                          size_t hop_limit) const {
+    for (VertexId vertex : state.touched) {
+        state.witness_weights[vertex].reset();
+    }
+    state.touched.clear();
+
+    PriorityQueue queue;
+    state.witness_weights[source] = ZERO_WEIGHT;
+    state.witness_hops[source] = 0;
+    state.touched.push_back(source);
+    queue.push({ZERO_WEIGHT, source});
+
+    size_t settled = 0;
+    while (!queue.empty() && settled < WITNESS_SETTLE_LIMIT) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > *state.witness_weights[vertex]) {
+            continue;
+        }
+        if (max_weight < weight) {
+            break;
+        }
+        ++settled;
+        const size_t hops = state.witness_hops[vertex] + 1;
+        for (const size_t edge_index : state.out_edges[vertex]) {
+            const auto& edge = edges_[edge_index];
+            if (edge.to == excluded || state.is_contracted[edge.to]) {
+                continue;
+            }
+            const Weight candidate_weight = weight + edge.weight;
+            auto& relaxing = state.witness_weights[edge.to];
+            if (!relaxing) {
+                state.touched.push_back(edge.to);
+            }
+            if (!relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                state.witness_hops[edge.to] = hops;
+                //the weight found on the last hop is a witness already, there is nothing to scan past it
+                if (hops < hop_limit) {
+                    queue.push({candidate_weight, edge.to});
+                }
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::vector<typename ContractionHierarchyRouter<Weight>::Shortcut>
+ContractionHierarchyRouter<Weight>::FindShortcuts(ContractionState& state, VertexId vertex, size_t hop_limit) const {
+    DropContractedEdges(state, vertex);
+    //keep only the lightest edge per neighbour
+    auto collect_lightest = [&](const std::vector<size_t>& edge_indexes, auto get_neighbor) {
+        std::vector<size_t> lightest;
+        for (const size_t edge_index : edge_indexes) {
+            const VertexId neighbor = get_neighbor(edges_[edge_index]);
+            size_t& neighbor_edge = state.neighbor_edges[neighbor];
+            if (neighbor_edge == NO_CHILD) {
+                neighbor_edge = lightest.size();
+                lightest.push_back(edge_index);
+            } else if (edges_[edge_index].weight < edges_[lightest[neighbor_edge]].weight) {
+                lightest[neighbor_edge] = edge_index;
+            }
+        }
+        for (const size_t edge_index : lightest) {
+            state.neighbor_edges[get_neighbor(edges_[edge_index])] = NO_CHILD;
+        }
+        return lightest;
+    };
+    const auto in_edges = collect_lightest(state.in_edges[vertex], [](const HierarchyEdge& edge) { return edge.from; });
+    const auto out_edges = collect_lightest(state.out_edges[vertex], [](const HierarchyEdge& edge) { return edge.to; });
+
+    std::vector<Shortcut> shortcuts;
+    if (out_edges.empty()) {
+        return shortcuts;
+    }
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (const size_t out_edge : out_edges) {
+        max_out_weight = std::max(max_out_weight, edges_[out_edge].weight);
+    }
+
+    for (const size_t in_edge : in_edges) {
+        const VertexId source = edges_[in_edge].from;
+        RunWitnessSearch(state, source, vertex, edges_[in_edge].weight + max_out_weight, hop_limit);
+        for (const size_t out_edge : out_edges) {
+            const VertexId target = edges_[out_edge].to;
+            if (target == source) {
+                continue;
+            }
+            const Weight through_weight = edges_[in_edge].weight + edges_[out_edge].weight;
+            const auto& witness_weight = state.witness_weights[target];
+            if (!witness_weight || through_weight < *witness_weight) {
+                shortcuts.push_back({in_edge, out_edge});
+            }
+        }
+    }
+    return shortcuts;
+}
+
+template <typename Weight>
+int ContractionHierarchyRouter<Weight>::GetContractionPriority(ContractionState& state, VertexId vertex) const {
+    //the shortcuts first, finding them drops the edges of the contracted neighbours
+    const int added_edges = static_cast<int>(FindShortcuts(state, vertex, PRIORITY_HOP_LIMIT).size());
+    const int removed_edges = static_cast<int>(state.in_edges[vertex].size() + state.out_edges[vertex].size());
+    return added_edges - removed_edges + state.contracted_neighbors[vertex];
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::ContractVertex(ContractionState& state, VertexId vertex) {
+    for (const auto& [first_edge, second_edge] : FindShortcuts(state, vertex, CONTRACTION_HOP_LIMIT)) {
+        const auto& first = edges_[first_edge];
+        const auto& second = edges_[second_edge];
+        AddHierarchyEdge(state, {first.from, second.to, first.weight + second.weight, first_edge, second_edge});
+    }
+    state.is_contracted[vertex] = true;
+
+    //a neighbour linked both ways is counted once, the marks of neighbor_edges are borrowed for it
+    std::vector<VertexId> neighbors;
+    auto add_neighbor = [&](VertexId neighbor) {
+        if (state.neighbor_edges[neighbor] == NO_CHILD) {
+            state.neighbor_edges[neighbor] = neighbors.size();
+            neighbors.push_back(neighbor);
+        }
+    };
+    for (const size_t edge_index : state.out_edges[vertex]) {
+        add_neighbor(edges_[edge_index].to);
+    }
+    for (const size_t edge_index : state.in_edges[vertex]) {
+        add_neighbor(edges_[edge_index].from);
+    }
+    for (const VertexId neighbor : neighbors) {
+        state.neighbor_edges[neighbor] = NO_CHILD;
+        ++state.contracted_neighbors[neighbor];
+        state.is_stale[neighbor] = true;
+    }
+    state.out_edges[vertex] = {};
+    state.in_edges[vertex] = {};
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::ContractGraph() {
+    const size_t vertex_count = graph_.GetVertexCount();
+
+    ContractionState state;
+    state.out_edges.resize(vertex_count);
+    state.in_edges.resize(vertex_count);
+    state.is_contracted.assign(vertex_count, false);
+    state.contracted_neighbors.assign(vertex_count, 0);
+    state.is_stale.assign(vertex_count, false);
+    state.neighbor_edges.assign(vertex_count, NO_CHILD);
+    state.witness_weights.resize(vertex_count);
+    state.witness_hops.assign(vertex_count, 0);
+    for (size_t edge_index = 0; edge_index < edges_.size(); ++edge_index) {
+        const auto& edge = edges_[edge_index];
+        if (edge.from != edge.to) {
+            state.out_edges[edge.from].push_back(edge_index);
+            state.in_edges[edge.to].push_back(edge_index);
+        }
+    }
+
+    using PriorityItem = std::pair<int, VertexId>;
+    std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> order;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        order.push({GetContractionPriority(state, vertex), vertex});
+    }
+
+    //every vertex has one entry in the queue. Only the neighbours of the contracted vertexes
+    //get new priorities, when their entries come up; an entry still the smallest is contracted
+    size_t next_rank = 0;
+    while (!order.empty()) {
+        const VertexId vertex = order.top().second;
+        order.pop();
+        if (state.is_stale[vertex]) {
+            state.is_stale[vertex] = false;
+            const int priority = GetContractionPriority(state, vertex);
+            if (!order.empty() && priority > order.top().first) {
+                order.push({priority, vertex});
+                continue;
+            }
+        }
+        ContractVertex(state, vertex);
+        rank_[vertex] = next_rank++;
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::PackSearchArcs() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (edges_.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("Too many edges for the contraction hierarchy");
+    }
+    //an edge is searched from its lower end, the one contracted earlier
+    auto get_side = [this](const HierarchyEdge& edge) {
+        return rank_[edge.from] < rank_[edge.to] ? 0 : 1;
+    };
+    auto get_lower = [this](const HierarchyEdge& edge) {
+        return rank_[edge.from] < rank_[edge.to] ? edge.from : edge.to;
+    };
+    for (size_t side = 0; side < 2; ++side) {
+        search_offsets_[side].assign(vertex_count + 1, 0);
+    }
+    for (const auto& edge : edges_) {
+        if (edge.from != edge.to) {
+            ++search_offsets_[get_side(edge)][get_lower(edge) + 1];
+        }
+    }
+    for (size_t side = 0; side < 2; ++side) {
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            search_offsets_[side][vertex + 1] += search_offsets_[side][vertex];
+        }
+        search_arcs_[side].resize(search_offsets_[side].back());
+    }
+    std::vector<size_t> next_arcs[2] = {search_offsets_[0], search_offsets_[1]};
+    for (size_t edge_index = 0; edge_index < edges_.size(); ++edge_index) {
+        const auto& edge = edges_[edge_index];
+        if (edge.from == edge.to) {
+            continue;
+        }
+        const size_t side = get_side(edge);
+        const VertexId higher = side == 0 ? edge.to : edge.from;
+        search_arcs_[side][next_arcs[side][get_lower(edge)]++] = {static_cast<std::uint32_t>(edge_index),
+                                                                   static_cast<std::uint32_t>(higher), edge.weight};
+    }
+}
+
+template <typename Weight>
+typename ContractionHierarchyRouter<Weight>::ArcsRange
+ContractionHierarchyRouter<Weight>::GetSearchArcs(size_t side, VertexId vertex) const {
+    return {search_arcs_[side].data() + search_offsets_[side][vertex],
+            search_arcs_[side].data() + search_offsets_[side][vertex + 1]};
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::UnpackEdge(size_t hierarchy_edge, std::vector<EdgeId>& edges) const {
+    std::vector<size_t> stack{hierarchy_edge};
+    while (!stack.empty()) {
+        const size_t edge_index = stack.back();
+        const auto& edge = edges_[edge_index];
+        stack.pop_back();
+        if (edge.first_child == NO_CHILD) {
+            edges.push_back(edge_index);
+            continue;
+        }
+        //the second half goes first, so the first half is unpacked first
+        stack.push_back(edge.second_child);
+        stack.push_back(edge.first_child);
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo>
+ContractionHierarchyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    //index 0 is the forward search from `from`, index 1 the backward search from `to`
+    std::vector<std::optional<Weight>> weights[2] = {std::vector<std::optional<Weight>>(vertex_count),
+                                                     std::vector<std::optional<Weight>>(vertex_count)};
+    std::vector<size_t> prev_edges[2] = {std::vector<size_t>(vertex_count, NO_CHILD),
+                                         std::vector<size_t>(vertex_count, NO_CHILD)};
+    PriorityQueue queues[2];
+    weights[0][from] = ZERO_WEIGHT;
+    weights[1][to] = ZERO_WEIGHT;
+    queues[0].push({ZERO_WEIGHT, from});
+    queues[1].push({ZERO_WEIGHT, to});
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    while (!queues[0].empty() || !queues[1].empty()) {
+        const size_t side = queues[1].empty() ? 0
+                          : queues[0].empty() ? 1
+                          : (queues[1].top().weight < queues[0].top().weight ? 1 : 0);
+        const auto [weight, vertex] = queues[side].top();
+        if (best_weight && !(weight < *best_weight)) {
+            //every remaining entry on this side is at least as heavy
+            queues[side] = PriorityQueue{};
+            continue;
+        }
+        queues[side].pop();
+        if (weight > *weights[side][vertex]) {
+            continue;
+        }
+        if (const auto& other_weight = weights[1 - side][vertex]) {
+            if (!best_weight || weight + *other_weight < *best_weight) {
+                best_weight = weight + *other_weight;
+                meeting_vertex = vertex;
+            }
+        }
+
+        for (const Arc& arc : GetSearchArcs(side, vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (auto& relaxing = weights[side][arc.vertex]; !relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                prev_edges[side][arc.vertex] = arc.edge_id;
+                queues[side].push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<size_t> hierarchy_path;
+    for (VertexId vertex = meeting_vertex; prev_edges[0][vertex] != NO_CHILD; vertex = edges_[prev_edges[0][vertex]].from) {
+        hierarchy_path.push_back(prev_edges[0][vertex]);
+    }
+    std::reverse(hierarchy_path.begin(), hierarchy_path.end());
+    for (VertexId vertex = meeting_vertex; prev_edges[1][vertex] != NO_CHILD; vertex = edges_[prev_edges[1][vertex]].to) {
+        hierarchy_path.push_back(prev_edges[1][vertex]);
+    }
+
+    std::vector<EdgeId> edges;
+    for (const size_t hierarchy_edge : hierarchy_path) {
+        UnpackEdge(hierarchy_edge, edges);
+    }
+
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Answers every query with its own Dijkstra search over the incidence lists,
+// so nothing is precomputed and memory stays linear in the graph size.
+// Given a heuristic (a consistent lower bound of the weight from a vertex to the target)
+// the search becomes A* and settles only the vertexes heading towards the target.
+template <typename Weight>
+class DijkstraRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using Heuristic = std::function<Weight(VertexId vertex, VertexId target)>;
+
+    explicit DijkstraRouter(const Graph& graph, Heuristic heuristic = nullptr);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    //peak bytes of one query: the per-vertex labels and the queue, which holds at most one entry per edge
+    static size_t EstimateQueryMemoryUsage(size_t vertex_count, size_t edge_count);
+
+private:
+    struct QueueItem {
+        //weight from the origin plus the heuristic estimate
+        Weight priority;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return priority > other.priority;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    Heuristic heuristic_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, Heuristic heuristic)
+    : graph_(graph)
+    , heuristic_(std::move(heuristic))
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+size_t DijkstraRouter<Weight>::EstimateQueryMemoryUsage(size_t vertex_count, size_t edge_count) {
+    return vertex_count * (sizeof(std::optional<Weight>) + sizeof(std::optional<EdgeId>))
+         + (edge_count + 1) * sizeof(QueueItem);
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::optional<Weight>> weights(vertex_count);
+    std::vector<std::optional<EdgeId>> prev_edges(vertex_count);
+
+    PriorityQueue queue;
+    weights[from] = ZERO_WEIGHT;
+    queue.push({heuristic_ ? heuristic_(from, to) : ZERO_WEIGHT, ZERO_WEIGHT, from});
+
+    while (!queue.empty()) {
+        const auto [priority, weight, vertex] = queue.top();
+        queue.pop();
+        //skip the stale entries left by the lazy deletion
+        if (weight > *weights[vertex]) {
+            continue;
+        }
+        if (vertex == to) {
+            break;
+        }
+        for (const auto& arc : graph_.GetIncidentArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (auto& relaxing = weights[arc.vertex]; !relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                prev_edges[arc.vertex] = arc.edge_id;
+                queue.push({heuristic_ ? candidate_weight + heuristic_(arc.vertex, to) : candidate_weight,
+                            candidate_weight, arc.vertex});
+            }
+        }
+    }
+
+    if (!weights[to]) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = prev_edges[to];
+         edge_id;
+         edge_id = prev_edges[graph_.GetEdge(*edge_id).from])
+    {
+        edges.push_back(*edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{*weights[to], std::move(edges)};
+}
+
+// Weights of the shortest paths from source to every vertex (backward: from every vertex
+// to source), nullopt where there is no path. No predecessors are kept.
+template <typename Weight>
+std::vector<std::optional<Weight>> ComputeShortestWeights(const DirectedWeightedGraph<Weight>& graph, VertexId source,
+                                                          bool backward = false) {
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    std::vector<std::optional<Weight>> weights(graph.GetVertexCount());
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    weights.at(source) = Weight{};
+    queue.push({Weight{}, source});
+
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > *weights[vertex]) {
+            continue;
+        }
+        for (const auto& arc : backward ? graph.GetIncomingArcs(vertex) : graph.GetIncidentArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (auto& relaxing = weights[arc.vertex]; !relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+    return weights;
+}
+
+// Vertexes reachable from source by paths no heavier than max_weight with the weights of their
+// shortest paths, in the order the search settles them (by weight). The search stops as soon as
+// its frontier passes max_weight.
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> ComputeWeightsWithin(const DirectedWeightedGraph<Weight>& graph, VertexId source,
+                                                              Weight max_weight) {
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    std::vector<std::pair<VertexId, Weight>> settled;
+    std::vector<std::optional<Weight>> weights(graph.GetVertexCount());
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    weights.at(source) = Weight{};
+    queue.push({Weight{}, source});
+
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > *weights[vertex]) {
+            continue;
+        }
+        if (max_weight < weight) {
+            break;
+        }
+        settled.emplace_back(vertex, weight);
+        for (const auto& arc : graph.GetIncidentArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (max_weight < candidate_weight) {
+                continue;
+            }
+            if (auto& relaxing = weights[arc.vertex]; !relaxing || candidate_weight < *relaxing) {
+                relaxing = candidate_weight;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+    return settled;
+}
+
+}  // namespace graph
@@ -150,13 +150,95 @@ namespace catalogue {
                     return *this;
                 }
             };
+
+            struct RouteMatrix : public InlineObjectBuilder<RouteMatrix> {
+                std::vector<std::string> from;
+                std::vector<std::string> to;
+
+                RouteMatrix& SetFrom(std::vector<std::string> origins) {
+                    from = std::move(origins);
+                    return *this;
+                }
+                
+                RouteMatrix& SetTo(std::vector<std::string> destinations) {
+                    to = std::move(destinations);
+                    return *this;
+                }
+            };
+
+            struct Isochrone : public InlineObjectBuilder<Isochrone> {
+                std::string from;
+                //minutes
+                double max_time;
+
+                Isochrone& SetFrom(std::string origin) {
+                    from = std::move(origin);
+                    return *this;
+                }
+
+                Isochrone& SetMaxTime(double minutes) {
+                    max_time = minutes;
+                    return *this;
+                }
+            };
         
 			std::deque<std::shared_ptr<StatRequest>> requests;
 		};
 
+        enum class RouterEngine {
+            //all-pairs table precomputed at startup
+            ALL_PAIRS,
+            //the same table in contiguous arrays with sentinels
+            COMPACT_ALL_PAIRS,
+            //compact table with float weights
+            COMPACT_FLOAT_ALL_PAIRS,
+            //compact table with fixed-point integer weights, built by the vectorized min-plus kernel
+            FIXED_POINT_ALL_PAIRS,
+            //one search per request, nothing precomputed
+            DIJKSTRA,
+            //full search per origin, the trees of the recent origins are cached
+            SHORTEST_PATH_TREES,
+            //one search per request, grown from both ends
+            BIDIRECTIONAL_DIJKSTRA,
+            //one search per request, guided towards the target by geo distances
+            A_STAR,
+            //one search per request, guided by precomputed landmark weights (ALT)
+            LANDMARKS,
+            //shortcut hierarchy precomputed at startup, bidirectional upward search per request
+            CONTRACTION_HIERARCHY,
+            //hub labels precomputed at startup (pruned landmark labeling), a label merge per weight query
+            HUB_LABELS,
+            //rounds over the bus stop sequences (RAPTOR), no routing graph at all
+            ROUTE_PATTERNS,
+            //a precomputed table when it fits RouterSettings::memory_budget, one search per request otherwise
+            AUTO,
+        };
+
         struct RouterSettings {
             int bus_wait_time;
             double bus_velocity;
+            RouterEngine engine = RouterEngine::ALL_PAIRS;
+            //workers building the graph and the all-pairs tables, 0 means one per hardware thread
+            size_t build_threads = 1;
+            //keep only the best of the parallel edges between two vertexes (the route items may then
+            //name another bus of the same time), the number of edges dropped is logged
+            bool prune_dominated_edges = false;
+            //one graph vertex per stop with the wait folded into the boarding edges
+            bool single_vertex_per_stop = false;
+            //landmarks of the ALT engine
+            size_t landmark_count = 8;
+            //print the ALT memory and a sample query time comparison at startup
+            bool report_landmark_stats = false;
+            //origins whose shortest path trees are kept by the tree cache
+            size_t route_tree_cache_size = 64;
+            //print the hits and misses of the tree cache once the requests are answered
+            bool report_route_cache_stats = false;
+            //workers answering batched requests, 0 means one per hardware thread
+            size_t query_threads = 0;
+            //file the all-pairs engines load their graph and table from (written when missing or stale)
+            std::string snapshot_path;
+            //bytes the automatically chosen engine may take on top of the graph, 0 means no limit
+            size_t memory_budget = 0;
 
             RouterSettings& SetBusWaitTime(int minutes) {
                 bus_wait_time = minutes;
@@ -167,6 +249,61 @@ namespace catalogue {
                 bus_velocity = kmph;
                 return *this;
             }
+
+            RouterSettings& SetEngine(RouterEngine value) {
+                engine = value;
+                return *this;
+            }
+
+            RouterSettings& SetBuildThreads(size_t count) {
+                build_threads = count;
+                return *this;
+            }
+
+            RouterSettings& SetPruneDominatedEdges(bool value) {
+                prune_dominated_edges = value;
+                return *this;
+            }
+
+            RouterSettings& SetSingleVertexPerStop(bool value) {
+                single_vertex_per_stop = value;
+                return *this;
+            }
+
+            RouterSettings& SetLandmarkCount(size_t count) {
+                landmark_count = count;
+                return *this;
+            }
+
+            RouterSettings& SetReportLandmarkStats(bool value) {
+                report_landmark_stats = value;
+                return *this;
+            }
+
+            RouterSettings& SetRouteTreeCacheSize(size_t count) {
+                route_tree_cache_size = count;
+                return *this;
+            }
+
+            RouterSettings& SetReportRouteCacheStats(bool value) {
+                report_route_cache_stats = value;
+                return *this;
+            }
+
+            RouterSettings& SetQueryThreads(size_t count) {
+                query_threads = count;
+                return *this;
+            }
+
+            RouterSettings& SetSnapshotPath(std::string path) {
+                snapshot_path = std::move(path);
+                return *this;
+            }
+
+            RouterSettings& SetMemoryBudget(size_t bytes) {
+                memory_budget = bytes;
+                return *this;
+            }
         };
 	 
 		struct Stop { 
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GRAPH_MIN_PLUS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace graph {
+
+namespace min_plus {
+
+using FixedWeight = std::int32_t;
+using EdgeIndex = std::uint32_t;
+
+// Twice the sentinel still fits FixedWeight, so the kernels add without overflow checks:
+// a sum involving the sentinel is never below a stored weight
+constexpr FixedWeight INFINITE_WEIGHT = (FixedWeight{1} << 30) - 1;
+
+// One min-plus row update of Floyd-Warshall through vertex k:
+//     row_from[j] = min(row_from[j], weight_from + row_through[j])
+// and the predecessor of j is taken from the through row wherever the row improves.
+// The through row never improves a cell it has no predecessor for (its diagonal and
+// its unreachable cells), so no sentinel test is needed per cell.
+using RowKernel = void (*)(FixedWeight weight_from, const FixedWeight* row_through, const EdgeIndex* prev_row_through,
+                           FixedWeight* row_from, EdgeIndex* prev_row_from, size_t count);
+
+inline void RelaxRowScalar(FixedWeight weight_from, const FixedWeight* row_through, const EdgeIndex* prev_row_through,
+                           FixedWeight* row_from, EdgeIndex* prev_row_from, size_t count) {
+    for (size_t index = 0; index < count; ++index) {
+        const FixedWeight candidate_weight = weight_from + row_through[index];
+        const bool is_better = candidate_weight < row_from[index];
+        row_from[index] = is_better ? candidate_weight : row_from[index];
+        prev_row_from[index] = is_better ? prev_row_through[index] : prev_row_from[index];
+    }
+}
+
+#ifdef GRAPH_MIN_PLUS_X86_KERNELS
+
+__attribute__((target("sse4.1")))
+inline void RelaxRowSse41(FixedWeight weight_from, const FixedWeight* row_through, const EdgeIndex* prev_row_through,
+                          FixedWeight* row_from, EdgeIndex* prev_row_from, size_t count) {
+    const __m128i weight = _mm_set1_epi32(weight_from);
+    size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        const __m128i candidate = _mm_add_epi32(weight, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_through + index)));
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_from + index));
+        const __m128i is_better = _mm_cmpgt_epi32(current, candidate);
+        //most rows stop improving after the first few vertexes, so untouched blocks are not written
+        if (_mm_testz_si128(is_better, is_better)) {
+            continue;
+        }
+        const __m128i prev_through = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row_through + index));
+        const __m128i prev_current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev_row_from + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row_from + index), _mm_blendv_epi8(current, candidate, is_better));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(prev_row_from + index), _mm_blendv_epi8(prev_current, prev_through, is_better));
+    }
+    RelaxRowScalar(weight_from, row_through + index, prev_row_through + index,
+                   row_from + index, prev_row_from + index, count - index);
+}
+
+__attribute__((target("avx2")))
+inline void RelaxRowAvx2(FixedWeight weight_from, const FixedWeight* row_through, const EdgeIndex* prev_row_through,
+                         FixedWeight* row_from, EdgeIndex* prev_row_from, size_t count) {
+    const __m256i weight = _mm256_set1_epi32(weight_from);
+    size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        const __m256i candidate = _mm256_add_epi32(weight, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_through + index)));
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_from + index));
+        const __m256i is_better = _mm256_cmpgt_epi32(current, candidate);
+        if (_mm256_testz_si256(is_better, is_better)) {
+            continue;
+        }
+        const __m256i prev_through = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row_through + index));
+        const __m256i prev_current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev_row_from + index));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(row_from + index), _mm256_blendv_epi8(current, candidate, is_better));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(prev_row_from + index), _mm256_blendv_epi8(prev_current, prev_through, is_better));
+    }
+    RelaxRowSse41(weight_from, row_through + index, prev_row_through + index,
+                  row_from + index, prev_row_from + index, count - index);
+}
+
+#endif
+
+// The widest kernel the running processor supports, chosen once
+inline RowKernel GetRowKernel() {
+    static const RowKernel kernel = [] {
+#ifdef GRAPH_MIN_PLUS_X86_KERNELS
+        if (__builtin_cpu_supports("avx2")) {
+            return &RelaxRowAvx2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return &RelaxRowSse41;
+        }
+#endif
+        return &RelaxRowScalar;
+    }();
+    return kernel;
+}
+
+}  // namespace min_plus
+
+// All-pairs table like CompactRouter, with the weights rounded to integer units
+// (units_per_weight of them per weight unit) so Floyd-Warshall runs on the vectorized
+// min-plus kernel. Each edge weight is rounded to the nearest unit, so the chosen route
+// is at most half a unit per edge (of it and of the optimal route) longer than the
+// optimal one. The reported weight is summed from the exact edge weights of the route.
+template <typename Weight>
+class FixedPointRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using FixedWeight = min_plus::FixedWeight;
+    using CompactEdgeId = min_plus::EdgeIndex;
+
+    FixedPointRouter(const Graph& graph, double units_per_weight, size_t thread_count = 1);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    // Whether every route weight surely stays below the sentinel: no simple path is heavier
+    // than the sum of the heaviest outgoing edges of its vertexes
+    static bool CanRepresent(const Graph& graph, double units_per_weight);
+    //bytes of the table for a graph of vertex_count vertexes
+    static size_t EstimateMemoryUsage(size_t vertex_count);
+
+    static constexpr FixedWeight INFINITE_WEIGHT = min_plus::INFINITE_WEIGHT;
+    static constexpr CompactEdgeId NO_EDGE = std::numeric_limits<CompactEdgeId>::max();
+
+private:
+    size_t GetCellIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
+    FixedWeight ToFixedWeight(Weight weight) const {
+        return static_cast<FixedWeight>(std::llround(static_cast<double>(weight) * units_per_weight_));
+    }
+
+    // Parallel edges are told apart by their exact weights, so the rounding never picks
+    // the heavier of two direct edges
+    void InitializeRoutesInternalData() {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights_[GetCellIndex(vertex, vertex)] = 0;
+            for (const auto& arc : graph_.GetIncidentArcs(vertex)) {
+                if (arc.vertex == vertex) {
+                    continue;
+                }
+                const size_t cell = GetCellIndex(vertex, arc.vertex);
+                if (prev_edges_[cell] == NO_EDGE || arc.weight < graph_.GetEdge(prev_edges_[cell]).weight) {
+                    weights_[cell] = ToFixedWeight(arc.weight);
+                    prev_edges_[cell] = static_cast<CompactEdgeId>(arc.edge_id);
+                }
+            }
+        }
+    }
+
+    void RelaxRoutesInternalDataThroughVertex(VertexId vertex_from_first, VertexId vertex_from_last,
+                                              VertexId vertex_through, min_plus::RowKernel kernel) {
+        const FixedWeight* row_through = weights_.data() + GetCellIndex(vertex_through, 0);
+        const CompactEdgeId* prev_row_through = prev_edges_.data() + GetCellIndex(vertex_through, 0);
+
+        for (VertexId vertex_from = vertex_from_first; vertex_from < vertex_from_last; ++vertex_from) {
+            const FixedWeight weight_from = weights_[GetCellIndex(vertex_from, vertex_through)];
+            if (weight_from == INFINITE_WEIGHT || vertex_from == vertex_through) {
+                continue;
+            }
+            kernel(weight_from, row_through, prev_row_through,
+                   weights_.data() + GetCellIndex(vertex_from, 0), prev_edges_.data() + GetCellIndex(vertex_from, 0),
+                   vertex_count_);
+        }
+    }
+
+    void RelaxRoutesInternalData(size_t thread_count) {
+        const min_plus::RowKernel kernel = min_plus::GetRowKernel();
+        thread_count = std::max<size_t>(1, std::min(thread_count, vertex_count_));
+        parallel::Barrier barrier(thread_count);
+        parallel::ForEachWorker(thread_count, [&](size_t worker, size_t worker_count) {
+            const auto [first, last] = parallel::GetChunk(vertex_count_, worker, worker_count);
+            for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+                RelaxRoutesInternalDataThroughVertex(first, last, vertex_through, kernel);
+                if (worker_count > 1) {
+                    barrier.ArriveAndWait();
+                }
+            }
+        });
+    }
+
+    const Graph& graph_;
+    const size_t vertex_count_;
+    const double units_per_weight_;
+    std::vector<FixedWeight> weights_;
+    std::vector<CompactEdgeId> prev_edges_;
+};
+
+template <typename Weight>
+FixedPointRouter<Weight>::FixedPointRouter(const Graph& graph, double units_per_weight, size_t thread_count)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , units_per_weight_(units_per_weight)
+{
+    if (graph.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for the compact router table");
+    }
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+    if (!CanRepresent(graph, units_per_weight)) {
+        throw std::overflow_error("Route weights exceed the fixed-point router table");
+    }
+    weights_.assign(vertex_count_ * vertex_count_, INFINITE_WEIGHT);
+    prev_edges_.assign(vertex_count_ * vertex_count_, NO_EDGE);
+
+    InitializeRoutesInternalData();
+    RelaxRoutesInternalData(parallel::ResolveWorkerCount(thread_count));
+}
+
+template <typename Weight>
+bool FixedPointRouter<Weight>::CanRepresent(const Graph& graph, double units_per_weight) {
+    double max_route_weight = 0;
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        double max_edge_weight = 0;
+        for (const auto& arc : graph.GetIncidentArcs(vertex)) {
+            max_edge_weight = std::max(max_edge_weight, static_cast<double>(arc.weight));
+        }
+        //each edge may round half a unit up
+        max_route_weight += max_edge_weight * units_per_weight + 0.5;
+    }
+    return max_route_weight < INFINITE_WEIGHT;
+}
+
+template <typename Weight>
+size_t FixedPointRouter<Weight>::EstimateMemoryUsage(size_t vertex_count) {
+    return vertex_count * vertex_count * (sizeof(FixedWeight) + sizeof(CompactEdgeId));
+}
+
+template <typename Weight>
+std::optional<typename FixedPointRouter<Weight>::RouteInfo> FixedPointRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                 VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (weights_[GetCellIndex(from, to)] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    const CompactEdgeId* prev_row = prev_edges_.data() + GetCellIndex(from, 0);
+    for (CompactEdgeId edge_id = prev_row[to];
+         edge_id != NO_EDGE;
+         edge_id = prev_row[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    Weight weight{};
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+    return RouteInfo{weight, std::move(edges)};
+}
+
+}  // namespace graph
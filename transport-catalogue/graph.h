@@ -8,6 +8,12 @@
 #include <memory>
 #include <optional>
 #include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
 
 namespace graph {
 
@@ -21,43 +27,189 @@ namespace graph {
         Weight weight;
     };
 
+    // Edge as seen from one of its ends: the other end and the weight are copied in,
+    // so a traversal reads the adjacency only. The ids are narrowed to keep it at 16 bytes
+    template <typename Weight>
+    struct IncidentEdge {
+        std::uint32_t edge_id;
+        //the target of an outgoing edge, the source of an incoming one
+        std::uint32_t vertex;
+        Weight weight;
+    };
+
+    /*
+    The adjacency is a list per vertex while the graph is built. Freeze packs it into
+    compressed sparse rows: one offsets array and one contiguous array of incident edges
+    per direction, grouped by the vertex in edge id order. Adding an edge to a frozen
+    graph unpacks it again, re-weighting keeps it packed.
+    */
     template <typename Weight>
     class DirectedWeightedGraph {
     private:
-        using IncidenceList = std::vector<EdgeId>;
-        using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+        using Arc = IncidentEdge<Weight>;
+        using IncidenceList = std::vector<Arc>;
+
+        // Walks a run of incident edges yielding their ids
+        class EdgeIdIterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = EdgeId;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = EdgeId;
+
+            explicit EdgeIdIterator(const Arc* arc)
+                : arc_(arc) {
+            }
+            reference operator*() const {
+                return arc_ -> edge_id;
+            }
+            EdgeIdIterator& operator++() {
+                ++arc_;
+                return *this;
+            }
+            bool operator==(const EdgeIdIterator& other) const {
+                return arc_ == other.arc_;
+            }
+            bool operator!=(const EdgeIdIterator& other) const {
+                return arc_ != other.arc_;
+            }
+
+        private:
+            const Arc* arc_;
+        };
 
     public:
+        using IncidentEdgesRange = ranges::Range<EdgeIdIterator>;
+        using IncidentArcsRange = ranges::Range<const Arc*>;
+
         DirectedWeightedGraph() = default;
         explicit DirectedWeightedGraph(size_t vertex_count);
         EdgeId AddEdge(Edge<Weight> edge);
+        //the routers built over the graph have to be updated as well
+        void SetEdgeWeight(EdgeId edge_id, Weight weight);
+        //packs the adjacency once the graph is built, before the routers are
+        void Freeze();
+        bool IsFrozen() const;
 
         size_t GetVertexCount() const;
         size_t GetEdgeCount() const;
         const Edge<Weight>& GetEdge(EdgeId edge_id) const;
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+        //edges coming into the vertex, for the searches running backwards
+        IncidentEdgesRange GetIncomingEdges(VertexId vertex) const;
+        //the same edges with their other ends and weights
+        IncidentArcsRange GetIncidentArcs(VertexId vertex) const;
+        IncidentArcsRange GetIncomingArcs(VertexId vertex) const;
 
     private:
+        struct Adjacency {
+            //unpacked
+            std::vector<IncidenceList> lists;
+            //packed
+            std::vector<size_t> offsets;
+            std::vector<Arc> arcs;
+
+            IncidentArcsRange GetArcs(VertexId vertex, bool is_packed) const {
+                if (is_packed) {
+                    assert(vertex + 1 < offsets.size());
+                    return {arcs.data() + offsets[vertex], arcs.data() + offsets[vertex + 1]};
+                }
+                assert(vertex < lists.size());
+                const IncidenceList& list = lists[vertex];
+                return {list.data(), list.data() + list.size()};
+            }
+
+            void Pack() {
+                offsets.assign(lists.size() + 1, 0);
+                for (VertexId vertex = 0; vertex < lists.size(); ++vertex) {
+                    offsets[vertex + 1] = offsets[vertex] + lists[vertex].size();
+                }
+                arcs.clear();
+                arcs.reserve(offsets.back());
+                //every list is released as soon as it is copied, so the peak stays close to one copy
+                for (IncidenceList& list : lists) {
+                    arcs.insert(arcs.end(), list.begin(), list.end());
+                    list = {};
+                }
+                lists = {};
+            }
+
+            void Unpack() {
+                lists.resize(offsets.size() - 1);
+                for (VertexId vertex = 0; vertex < lists.size(); ++vertex) {
+                    lists[vertex].assign(arcs.begin() + offsets[vertex], arcs.begin() + offsets[vertex + 1]);
+                }
+                offsets = {};
+                arcs = {};
+            }
+
+            void SetWeight(VertexId vertex, EdgeId edge_id, Weight weight, bool is_packed) {
+                Arc* first = is_packed ? arcs.data() + offsets[vertex] : lists[vertex].data();
+                Arc* last = is_packed ? arcs.data() + offsets[vertex + 1] : first + lists[vertex].size();
+                for (Arc* arc = first; arc != last; ++arc) {
+                    if (arc -> edge_id == edge_id) {
+                        arc -> weight = weight;
+                    }
+                }
+            }
+        };
+
         std::vector<Edge<Weight>> edges_;
-        std::vector<IncidenceList> incidence_lists_;
+        Adjacency outgoing_;
+        Adjacency incoming_;
+        bool is_frozen_ = false;
     };
 
     template <typename Weight>
-    DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-        : incidence_lists_(vertex_count) {
+    DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) {
+        outgoing_.lists.resize(vertex_count);
+        incoming_.lists.resize(vertex_count);
     }
 
     template <typename Weight>
     EdgeId DirectedWeightedGraph<Weight>::AddEdge(Edge<Weight> edge) {
+        if (is_frozen_) {
+            outgoing_.Unpack();
+            incoming_.Unpack();
+            is_frozen_ = false;
+        }
+        assert(edge.from < outgoing_.lists.size() && edge.to < incoming_.lists.size());
+        assert(edges_.size() < std::numeric_limits<std::uint32_t>::max());
         edges_.push_back(edge);
         const EdgeId id = edges_.size() - 1;
-        incidence_lists_.at(edge.from).push_back(id);
+        const auto narrow_id = static_cast<std::uint32_t>(id);
+        outgoing_.lists[edge.from].push_back({narrow_id, static_cast<std::uint32_t>(edge.to), edge.weight});
+        incoming_.lists[edge.to].push_back({narrow_id, static_cast<std::uint32_t>(edge.from), edge.weight});
         return id;
     }
 
+    template <typename Weight>
+    void DirectedWeightedGraph<Weight>::SetEdgeWeight(EdgeId edge_id, Weight weight) {
+        assert(edge_id < edges_.size());
+        Edge<Weight>& edge = edges_[edge_id];
+        edge.weight = weight;
+        outgoing_.SetWeight(edge.from, edge_id, weight, is_frozen_);
+        incoming_.SetWeight(edge.to, edge_id, weight, is_frozen_);
+    }
+
+    template <typename Weight>
+    void DirectedWeightedGraph<Weight>::Freeze() {
+        if (!is_frozen_) {
+            outgoing_.Pack();
+            incoming_.Pack();
+            is_frozen_ = true;
+        }
+    }
+
+    template <typename Weight>
+    bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+        return is_frozen_;
+    }
+
     template <typename Weight>
     size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-        return incidence_lists_.size();
+        return is_frozen_ ? outgoing_.offsets.size() - 1 : outgoing_.lists.size();
     }
 
     template <typename Weight>
@@ -67,31 +219,59 @@ namespace graph {
 
     template <typename Weight>
     const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-        return edges_.at(edge_id);
+        assert(edge_id < edges_.size());
+        return edges_[edge_id];
     }
 
     template <typename Weight>
     typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
     DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-        return ranges::AsRange(incidence_lists_.at(vertex));
+        const IncidentArcsRange arcs = GetIncidentArcs(vertex);
+        return {EdgeIdIterator(arcs.begin()), EdgeIdIterator(arcs.end())};
     }
 
+    template <typename Weight>
+    typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
+    DirectedWeightedGraph<Weight>::GetIncomingEdges(VertexId vertex) const {
+        const IncidentArcsRange arcs = GetIncomingArcs(vertex);
+        return {EdgeIdIterator(arcs.begin()), EdgeIdIterator(arcs.end())};
+    }
 
+    template <typename Weight>
+    typename DirectedWeightedGraph<Weight>::IncidentArcsRange
+    DirectedWeightedGraph<Weight>::GetIncidentArcs(VertexId vertex) const {
+        return outgoing_.GetArcs(vertex, is_frozen_);
+    }
+
+    template <typename Weight>
+    typename DirectedWeightedGraph<Weight>::IncidentArcsRange
+    DirectedWeightedGraph<Weight>::GetIncomingArcs(VertexId vertex) const {
+        return incoming_.GetArcs(vertex, is_frozen_);
+    }
+
+
+    /*
+    Every stop is a portal vertex and a hub vertex, so the wait can be an edge of its own.
+    When the graph is built with a folded wait, the portal and the hub are the same
+    vertex and the wait is part of every boarding edge instead (4x smaller all-pairs
+    tables); its segments are still reported as a separate wait.
+    */
     template <typename Weight, typename Vertex>
     class DoubleVertexGraph : public DirectedWeightedGraph<Weight> {
     public: 
-        static VertexId SingleToDoubleVertexPos(VertexId vertex_id);
-        static VertexId DoubleToSingleVertexPos(VertexId vertex_id);
+        VertexId SingleToDoubleVertexPos(VertexId vertex_id) const;
+        VertexId DoubleToSingleVertexPos(VertexId vertex_id) const;
 
     public:
+        //the name refers to the vertex or path name storage, which outlives the graph
         struct EdgeSegmentInfo {
-            std::string name; 
+            std::string_view name; 
             int span_count;
             Weight weight;
                  
 
-            EdgeSegmentInfo& SetName(std::string value) {
-                name = std::move(value);
+            EdgeSegmentInfo& SetName(std::string_view value) {
+                name = value;
                 return *this;
             }      
 
@@ -112,21 +292,97 @@ namespace graph {
             int span_count;
         };
 
-        DoubleVertexGraph(std::vector<Vertex> vertexes);
+        // Walks the segments of a route straight from its edge ids, nothing is stored: with a folded
+        // wait a ride edge yields its wait first and then the ride itself
+        class SegmentIterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = EdgeSegmentInfo;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = EdgeSegmentInfo;
+
+            SegmentIterator() = default;
+            SegmentIterator(const DoubleVertexGraph& graph, const EdgeId* edge)
+                : graph_(&graph)
+                , edge_(edge) {
+            }
+            EdgeSegmentInfo operator*() const {
+                auto segment = graph_ -> GetEdgeSegmentInfo(*edge_);
+                if (!HasFoldedWait()) {
+                    return segment;
+                }
+                if (!is_ride_) {
+                    return EdgeSegmentInfo{}.SetName((*graph_ -> GetVertex(graph_ -> GetEdge(*edge_).from)) -> name)
+                                            .SetWeight(*graph_ -> folded_wait_)
+                                            .SetSpanCount(0);
+                }
+                return segment.SetWeight(segment.weight - *graph_ -> folded_wait_);
+            }
+            SegmentIterator& operator++() {
+                if (HasFoldedWait() && !is_ride_) {
+                    is_ride_ = true;
+                } else {
+                    ++edge_;
+                    is_ride_ = false;
+                }
+                return *this;
+            }
+            bool operator==(const SegmentIterator& other) const {
+                return edge_ == other.edge_ && is_ride_ == other.is_ride_;
+            }
+            bool operator!=(const SegmentIterator& other) const {
+                return !(*this == other);
+            }
+
+        private:
+            bool HasFoldedWait() const {
+                return graph_ -> folded_wait_ && graph_ -> edge_span_counts_[*edge_] > 0;
+            }
+
+            const DoubleVertexGraph* graph_ = nullptr;
+            const EdgeId* edge_ = nullptr;
+            bool is_ride_ = false;
+        };
+        using SegmentsRange = ranges::Range<SegmentIterator>;
+
+        DoubleVertexGraph(std::vector<Vertex> vertexes, std::optional<Weight> folded_wait = std::nullopt);
         void SetEdgePath(EdgeId edge, EdgePath path);
+        EdgePath GetEdgePath(EdgeId edge) const;
         const Vertex* GetVertex(VertexId double_vertex_id) const;
         const VertexId* GetVertexId(std::string_view vertex) const;
+        VertexId GetHubVertexId(VertexId portal_id) const;
+        const std::optional<Weight>& GetFoldedWait() const;
         EdgeSegmentInfo GetEdgeSegmentInfo(EdgeId edge_id) const;
+        //the wait and ride segments the edges of a route stand for, read as they are iterated
+        SegmentsRange GetRouteSegments(const std::vector<EdgeId>& edges) const;
 
     private:
+        static size_t GetVertexesPerStop(const std::optional<Weight>& folded_wait) {
+            return folded_wait ? 1 : 2;
+        }
+
+        std::optional<Weight> folded_wait_;
+        size_t vertexes_per_stop_;
         std::vector<Vertex> single_vertexes_;
-        std::unordered_map<EdgeId, EdgePath> edge_to_path_;
+        //interned path names, the edges refer to them by index
+        using PathId = std::uint32_t;
+
+        PathId InternPathName(std::string_view path_name);
+
+        //edge metadata in arrays indexed by the edge id
+        std::vector<PathId> edge_path_ids_;
+        std::vector<std::int32_t> edge_span_counts_;
+        std::vector<std::string_view> path_names_;
+        std::unordered_map<std::string_view, PathId> path_name_to_id_;
         std::unordered_map<std::string_view, VertexId> vertexname_to_double_vertex_id_;
     }; 
 
     template <typename Weight, typename Vertex>
-    DoubleVertexGraph<Weight, Vertex>::DoubleVertexGraph(std::vector<Vertex> vertexes)  
-    : graph::DirectedWeightedGraph<Weight>(SingleToDoubleVertexPos(vertexes.size())) 
+    DoubleVertexGraph<Weight, Vertex>::DoubleVertexGraph(std::vector<Vertex> vertexes, std::optional<Weight> folded_wait)  
+    : graph::DirectedWeightedGraph<Weight>(vertexes.size() * GetVertexesPerStop(folded_wait)) 
+    , folded_wait_(folded_wait)
+    , vertexes_per_stop_(GetVertexesPerStop(folded_wait))
     , single_vertexes_(std::move(vertexes)) {
 
         if (!single_vertexes_.empty()) {
@@ -142,18 +398,38 @@ namespace graph {
     }
 
     template <typename Weight, typename Vertex>
-    VertexId DoubleVertexGraph<Weight, Vertex>::SingleToDoubleVertexPos(VertexId vertex_id) {
-        return vertex_id * 2;
+    VertexId DoubleVertexGraph<Weight, Vertex>::SingleToDoubleVertexPos(VertexId vertex_id) const {
+        return vertex_id * vertexes_per_stop_;
+    }
+
+    template <typename Weight, typename Vertex>
+    VertexId DoubleVertexGraph<Weight, Vertex>::DoubleToSingleVertexPos(VertexId vertex_id) const {
+        return vertex_id / vertexes_per_stop_;
     }
 
     template <typename Weight, typename Vertex>
-    VertexId DoubleVertexGraph<Weight, Vertex>::DoubleToSingleVertexPos(VertexId vertex_id) {
-        return vertex_id / 2;
+    typename DoubleVertexGraph<Weight, Vertex>::PathId DoubleVertexGraph<Weight, Vertex>::InternPathName(std::string_view path_name) {
+        auto [iter, inserted] = path_name_to_id_.emplace(path_name, static_cast<PathId>(path_names_.size()));
+        if (inserted) {
+            path_names_.push_back(path_name);
+        }
+        return iter -> second;
     }
 
     template <typename Weight, typename Vertex>
     void DoubleVertexGraph<Weight, Vertex>::SetEdgePath(EdgeId edge, EdgePath path) {
-        edge_to_path_[edge] = std::move(path);
+        //edges are given their paths as they are added, so the arrays grow by one at a time
+        if (edge >= edge_path_ids_.size()) {
+            edge_path_ids_.resize(edge + 1);
+            edge_span_counts_.resize(edge + 1);
+        }
+        edge_path_ids_[edge] = InternPathName(path.path_name);
+        edge_span_counts_[edge] = path.span_count;
+    }
+
+    template <typename Weight, typename Vertex>
+    typename DoubleVertexGraph<Weight, Vertex>::EdgePath DoubleVertexGraph<Weight, Vertex>::GetEdgePath(EdgeId edge) const {
+        return {path_names_[edge_path_ids_.at(edge)], edge_span_counts_[edge]};
     }
 
     template <typename Weight, typename Vertex>
@@ -168,19 +444,36 @@ namespace graph {
         return result != vertexname_to_double_vertex_id_.end() ? &(result -> second) : nullptr;
     }
 
+    template <typename Weight, typename Vertex>
+    VertexId DoubleVertexGraph<Weight, Vertex>::GetHubVertexId(VertexId portal_id) const {
+        return portal_id + vertexes_per_stop_ - 1;
+    }
+
+    template <typename Weight, typename Vertex>
+    const std::optional<Weight>& DoubleVertexGraph<Weight, Vertex>::GetFoldedWait() const {
+        return folded_wait_;
+    }
+
     template <typename Weight, typename Vertex>
     typename DoubleVertexGraph<Weight, Vertex>::EdgeSegmentInfo 
     DoubleVertexGraph<Weight, Vertex>::GetEdgeSegmentInfo(EdgeId edge_id) const {
-        auto edge = this -> GetEdge(edge_id);
-        auto edge_path = edge_to_path_.at(edge_id);
+        const auto& edge = this -> GetEdge(edge_id);
+        assert(edge_id < edge_span_counts_.size());
+        const int span_count = edge_span_counts_[edge_id];
 
         auto vertex = GetVertex(edge.from);
         assert(vertex);
 
-        return EdgeSegmentInfo{}.SetName(edge_path.span_count > 0 ? std::string(edge_path.path_name) 
-                                        : (*vertex) -> name)
+        return EdgeSegmentInfo{}.SetName(span_count > 0 ? path_names_[edge_path_ids_[edge_id]] 
+                                        : std::string_view((*vertex) -> name))
                                 .SetWeight(edge.weight)
-                                .SetSpanCount(edge_path.span_count);
+                                .SetSpanCount(span_count);
+    }
+
+    template <typename Weight, typename Vertex>
+    typename DoubleVertexGraph<Weight, Vertex>::SegmentsRange 
+    DoubleVertexGraph<Weight, Vertex>::GetRouteSegments(const std::vector<EdgeId>& edges) const {
+        return {SegmentIterator(*this, edges.data()), SegmentIterator(*this, edges.data() + edges.size())};
     }
 
 
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Hub labeling built by pruned landmark labeling. Every vertex gets an out-label of (hub, weight
+// to the hub) and an in-label of (hub, weight from the hub), such that for any two vertexes some
+// hub common to the out-label of the origin and the in-label of the destination lies on a shortest
+// path between them. The hubs are taken in rank order (most edges first) and every hub runs a
+// forward and a backward search that stops wherever the labels built so far already give the weight,
+// so the labels stay small. Labels are kept in rank order and a weight query is a merge of two
+// sorted arrays. Every entry also keeps the edge leading towards its hub in the pruned search tree,
+// so a route is unpacked by walking those edges, without any search.
+template <typename Weight>
+class HubLabelRouter : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    struct Stats {
+        size_t vertex_count = 0;
+        size_t out_label_entries = 0;
+        size_t in_label_entries = 0;
+        size_t max_out_label_size = 0;
+        size_t max_in_label_size = 0;
+        //bytes held by the labels
+        size_t memory_usage = 0;
+    };
+
+    explicit HubLabelRouter(const Graph& graph);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    // Weight of the shortest path without its edges, nullopt when there is none
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const;
+    Stats GetStats() const;
+
+private:
+    using Rank = std::uint32_t;
+
+    struct LabelEntry {
+        Rank hub;
+        //the first edge from the vertex towards the hub (out-labels) or the last one from the hub
+        //to the vertex (in-labels), NO_EDGE in the hub's own entries; it fits the padding
+        std::uint32_t edge;
+        Weight weight;
+    };
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+    using Labels = std::vector<std::vector<LabelEntry>>;
+
+    // Labels packed like the graph: entries[offsets[vertex], offsets[vertex + 1])
+    struct PackedLabels {
+        std::vector<size_t> offsets;
+        std::vector<LabelEntry> entries;
+
+        void Pack(Labels& labels);
+        const LabelEntry* begin(VertexId vertex) const {
+            return entries.data() + offsets[vertex];
+        }
+        const LabelEntry* end(VertexId vertex) const {
+            return entries.data() + offsets[vertex + 1];
+        }
+        const LabelEntry& Find(VertexId vertex, Rank hub) const;
+    };
+
+    // Scratch of the pruned searches, reset after every search
+    struct SearchState {
+        std::vector<Weight> weights;
+        std::vector<std::uint32_t> prev_edges;
+        //the hub's own label by the ranks of its hubs
+        std::vector<Weight> hub_weights;
+        std::vector<VertexId> touched;
+    };
+
+    // The best common hub and the weight through it
+    std::optional<std::pair<Rank, Weight>> FindHub(VertexId from, VertexId to) const;
+    void RankVertexes();
+    // Search from the hub of the given rank; backward follows the edges against their direction and
+    // extends the out-labels, forward extends the in-labels
+    void RunPrunedSearch(Rank rank, bool backward, Labels& out_labels, Labels& in_labels, SearchState& state) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+                                            ? std::numeric_limits<Weight>::infinity()
+                                            : std::numeric_limits<Weight>::max();
+    static constexpr std::uint32_t NO_EDGE = std::numeric_limits<std::uint32_t>::max();
+
+    const Graph& graph_;
+    //vertexes by rank, the highest ranked hub first
+    std::vector<VertexId> hubs_;
+    PackedLabels out_labels_;
+    PackedLabels in_labels_;
+};
+
+template <typename Weight>
+HubLabelRouter<Weight>::HubLabelRouter(const Graph& graph)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph_.GetVertexCount();
+    RankVertexes();
+
+    Labels out_labels(vertex_count);
+    Labels in_labels(vertex_count);
+    SearchState state{std::vector<Weight>(vertex_count, INFINITE_WEIGHT), std::vector<std::uint32_t>(vertex_count, NO_EDGE),
+                      std::vector<Weight>(vertex_count, INFINITE_WEIGHT), {}};
+    for (Rank rank = 0; rank < hubs_.size(); ++rank) {
+        RunPrunedSearch(rank, false, out_labels, in_labels, state);
+        RunPrunedSearch(rank, true, out_labels, in_labels, state);
+    }
+    out_labels_.Pack(out_labels);
+    in_labels_.Pack(in_labels);
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::RankVertexes() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<size_t> scores(vertex_count);
+    hubs_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const auto outgoing = graph_.GetIncidentArcs(vertex);
+        const auto incoming = graph_.GetIncomingArcs(vertex);
+        //the vertexes many shortest paths run through have many edges both ways
+        scores[vertex] = static_cast<size_t>(outgoing.end() - outgoing.begin() + 1)
+                       * static_cast<size_t>(incoming.end() - incoming.begin() + 1);
+        hubs_[vertex] = vertex;
+    }
+    std::stable_sort(hubs_.begin(), hubs_.end(), [&scores](VertexId lhs, VertexId rhs) {
+        return scores[lhs] > scores[rhs];
+    });
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::RunPrunedSearch(Rank rank, bool backward, Labels& out_labels, Labels& in_labels,
+                                             SearchState& state) const {
+    const VertexId hub = hubs_[rank];
+    Labels& extended_labels = backward ? out_labels : in_labels;
+    const std::vector<LabelEntry>& hub_label = backward ? in_labels[hub] : out_labels[hub];
+    for (const LabelEntry& entry : hub_label) {
+        state.hub_weights[entry.hub] = entry.weight;
+    }
+
+    PriorityQueue queue;
+    state.weights[hub] = ZERO_WEIGHT;
+    state.touched.push_back(hub);
+    queue.push({ZERO_WEIGHT, hub});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > state.weights[vertex]) {
+            continue;
+        }
+        //the hubs ranked higher already give this weight
+        const auto& label = extended_labels[vertex];
+        const bool is_covered = vertex != hub && std::any_of(label.begin(), label.end(), [&](const LabelEntry& entry) {
+            return !(weight < state.hub_weights[entry.hub] + entry.weight);
+        });
+        if (is_covered) {
+            continue;
+        }
+        extended_labels[vertex].push_back({rank, state.prev_edges[vertex], weight});
+        for (const auto& arc : backward ? graph_.GetIncomingArcs(vertex) : graph_.GetIncidentArcs(vertex)) {
+            if (const Weight candidate_weight = weight + arc.weight; candidate_weight < state.weights[arc.vertex]) {
+                if (state.weights[arc.vertex] == INFINITE_WEIGHT) {
+                    state.touched.push_back(arc.vertex);
+                }
+                state.weights[arc.vertex] = candidate_weight;
+                state.prev_edges[arc.vertex] = arc.edge_id;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+
+    for (const VertexId vertex : state.touched) {
+        state.weights[vertex] = INFINITE_WEIGHT;
+        state.prev_edges[vertex] = NO_EDGE;
+    }
+    state.touched.clear();
+    for (const LabelEntry& entry : hub_label) {
+        state.hub_weights[entry.hub] = INFINITE_WEIGHT;
+    }
+}
+
+template <typename Weight>
+void HubLabelRouter<Weight>::PackedLabels::Pack(Labels& labels) {
+    offsets.assign(labels.size() + 1, 0);
+    for (VertexId vertex = 0; vertex < labels.size(); ++vertex) {
+        offsets[vertex + 1] = offsets[vertex] + labels[vertex].size();
+    }
+    entries.reserve(offsets.back());
+    for (auto& label : labels) {
+        entries.insert(entries.end(), label.begin(), label.end());
+        label = {};
+    }
+}
+
+template <typename Weight>
+const typename HubLabelRouter<Weight>::LabelEntry& HubLabelRouter<Weight>::PackedLabels::Find(VertexId vertex, Rank hub) const {
+    const LabelEntry* entry = std::lower_bound(begin(vertex), end(vertex), hub, [](const LabelEntry& entry, Rank rank) {
+        return entry.hub < rank;
+    });
+    assert(entry != end(vertex) && entry -> hub == hub);
+    return *entry;
+}
+
+template <typename Weight>
+std::optional<std::pair<typename HubLabelRouter<Weight>::Rank, Weight>>
+HubLabelRouter<Weight>::FindHub(VertexId from, VertexId to) const {
+    assert(from + 1 < out_labels_.offsets.size() && to + 1 < in_labels_.offsets.size());
+    std::optional<std::pair<Rank, Weight>> best;
+    const LabelEntry* out_entry = out_labels_.begin(from);
+    const LabelEntry* in_entry = in_labels_.begin(to);
+    const LabelEntry* const out_end = out_labels_.end(from);
+    const LabelEntry* const in_end = in_labels_.end(to);
+    while (out_entry != out_end && in_entry != in_end) {
+        if (out_entry -> hub < in_entry -> hub) {
+            ++out_entry;
+        } else if (in_entry -> hub < out_entry -> hub) {
+            ++in_entry;
+        } else {
+            if (const Weight candidate_weight = out_entry -> weight + in_entry -> weight; !best || candidate_weight < best -> second) {
+                best = {out_entry -> hub, candidate_weight};
+            }
+            ++out_entry;
+            ++in_entry;
+        }
+    }
+    return best;
+}
+
+template <typename Weight>
+std::optional<Weight> HubLabelRouter<Weight>::GetWeight(VertexId from, VertexId to) const {
+    if (const auto hub = FindHub(from, to)) {
+        return hub -> second;
+    }
+    return std::nullopt;
+}
+
+template <typename Weight>
+std::optional<typename HubLabelRouter<Weight>::RouteInfo> HubLabelRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from == to) {
+        return RouteInfo{ZERO_WEIGHT, {}};
+    }
+    const auto hub = FindHub(from, to);
+    if (!hub) {
+        return std::nullopt;
+    }
+    const auto [rank, weight] = *hub;
+    const VertexId hub_vertex = hubs_[rank];
+
+    //origin -> hub along the out-labels, then hub -> destination along the in-labels walked backwards
+    std::vector<EdgeId> edges;
+    for (VertexId vertex = from; vertex != hub_vertex;) {
+        const EdgeId edge_id = out_labels_.Find(vertex, rank).edge;
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).to;
+    }
+    const size_t hub_position = edges.size();
+    for (VertexId vertex = to; vertex != hub_vertex;) {
+        const EdgeId edge_id = in_labels_.Find(vertex, rank).edge;
+        edges.push_back(edge_id);
+        vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin() + hub_position, edges.end());
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+typename HubLabelRouter<Weight>::Stats HubLabelRouter<Weight>::GetStats() const {
+    Stats stats;
+    stats.vertex_count = hubs_.size();
+    stats.out_label_entries = out_labels_.entries.size();
+    stats.in_label_entries = in_labels_.entries.size();
+    for (VertexId vertex = 0; vertex < stats.vertex_count; ++vertex) {
+        stats.max_out_label_size = std::max<size_t>(stats.max_out_label_size, out_labels_.end(vertex) - out_labels_.begin(vertex));
+        stats.max_in_label_size = std::max<size_t>(stats.max_in_label_size, in_labels_.end(vertex) - in_labels_.begin(vertex));
+    }
+    stats.memory_usage = (stats.out_label_entries + stats.in_label_entries) * sizeof(LabelEntry)
+                       + (out_labels_.offsets.size() + in_labels_.offsets.size()) * sizeof(size_t)
+                       + hubs_.size() * sizeof(VertexId);
+    return stats;
+}
+
+}  // namespace graph
@@ -116,6 +116,28 @@ namespace json {
                                                          .SetTo(request.at("to"s).AsString()));
                         continue;                                                                 
                     }
+                    if (type == "RouteMatrix"sv) {
+                        auto to_names = [](const Array& stops) {
+                            std::vector<std::string> names;
+                            names.reserve(stops.size());
+                            for (const auto& stop : stops) {
+                                names.push_back(stop.AsString());
+                            }
+                            return names;
+                        };
+                        result.Add(StatRequests::RouteMatrix{}.SetId(id)
+                                                              .SetType(std::move(type))
+                                                              .SetFrom(to_names(request.at("from"s).AsArray()))
+                                                              .SetTo(to_names(request.at("to"s).AsArray())));
+                        continue;
+                    }
+                    if (type == "Isochrone"sv) {
+                        result.Add(StatRequests::Isochrone{}.SetId(id)
+                                                            .SetType(std::move(type))
+                                                            .SetFrom(request.at("from"s).AsString())
+                                                            .SetMaxTime(request.at("max_time"s).AsDouble()));
+                        continue;
+                    }
                     auto name_iter = request.find("name"s);
                     result.Add(StatRequests::Transport{}.SetId(id)
                                                                 .SetType(std::move(type))
@@ -158,8 +180,49 @@ namespace json {
 
         RouterSettings InputStandardizer::StandardizeRoutingSettings(const Dict& routing_settings) {
             try { 
-                return RouterSettings{}.SetBusVelocity(routing_settings.at("bus_velocity"s).AsDouble())
-                                        .SetBusWaitTime(routing_settings.at("bus_wait_time"s).AsInt());
+                auto settings = RouterSettings{}.SetBusVelocity(routing_settings.at("bus_velocity"s).AsDouble())
+                                                .SetBusWaitTime(routing_settings.at("bus_wait_time"s).AsInt());
+                //optional key, the all-pairs table is used by default
+                if (auto engine_iter = routing_settings.find("router_engine"s); engine_iter != routing_settings.end()) {
+                    settings.SetEngine(StandardizeRouterEngine(engine_iter -> second.AsString()));
+                }
+                if (auto threads_iter = routing_settings.find("router_build_threads"s); threads_iter != routing_settings.end()) {
+                    settings.SetBuildThreads(StandardizeCount(threads_iter -> second, "router_build_threads"sv));
+                }
+                if (auto prune_iter = routing_settings.find("prune_dominated_edges"s); prune_iter != routing_settings.end()) {
+                    settings.SetPruneDominatedEdges(prune_iter -> second.AsBool());
+                }
+                if (auto single_iter = routing_settings.find("single_vertex_per_stop"s); single_iter != routing_settings.end()) {
+                    settings.SetSingleVertexPerStop(single_iter -> second.AsBool());
+                }
+                if (auto landmarks_iter = routing_settings.find("landmark_count"s); landmarks_iter != routing_settings.end()) {
+                    settings.SetLandmarkCount(StandardizeCount(landmarks_iter -> second, "landmark_count"sv));
+                }
+                if (auto report_iter = routing_settings.find("report_landmark_stats"s); report_iter != routing_settings.end()) {
+                    settings.SetReportLandmarkStats(report_iter -> second.AsBool());
+                }
+                if (auto cache_iter = routing_settings.find("route_tree_cache_size"s); cache_iter != routing_settings.end()) {
+                    settings.SetRouteTreeCacheSize(StandardizeCount(cache_iter -> second, "route_tree_cache_size"sv));
+                }
+                if (auto report_iter = routing_settings.find("report_route_cache_stats"s); report_iter != routing_settings.end()) {
+                    settings.SetReportRouteCacheStats(report_iter -> second.AsBool());
+                }
+                if (auto threads_iter = routing_settings.find("query_threads"s); threads_iter != routing_settings.end()) {
+                    settings.SetQueryThreads(StandardizeCount(threads_iter -> second, "query_threads"sv));
+                }
+                if (auto snapshot_iter = routing_settings.find("router_snapshot"s); snapshot_iter != routing_settings.end()) {
+                    settings.SetSnapshotPath(snapshot_iter -> second.AsString());
+                }
+                //in megabytes, for the "auto" engine
+                if (auto budget_iter = routing_settings.find("router_memory_budget_mb"s); budget_iter != routing_settings.end()) {
+                    static const double BYTES_PER_MEGABYTE = 1024 * 1024;
+                    const double budget = budget_iter -> second.AsDouble();
+                    if (budget < 0) {
+                        throw ParsingError("Negative router_memory_budget_mb "s + std::to_string(budget));
+                    }
+                    settings.SetMemoryBudget(static_cast<size_t>(budget * BYTES_PER_MEGABYTE));
+                }
+                return settings;
             } catch (const std::exception& e) { 
                 std::cerr << "error while parsing render settings : "sv << e.what() << '\n'; 
             } 
@@ -193,6 +256,49 @@ namespace json {
             return color; 
         } 
 
+        RouterEngine InputStandardizer::StandardizeRouterEngine(const std::string& engine_name) { 
+            using namespace std::literals; 
+
+            if (engine_name == "all_pairs"sv) { 
+                return RouterEngine::ALL_PAIRS; 
+            } else if (engine_name == "compact"sv) { 
+                return RouterEngine::COMPACT_ALL_PAIRS; 
+            } else if (engine_name == "compact_float"sv) { 
+                return RouterEngine::COMPACT_FLOAT_ALL_PAIRS; 
+            } else if (engine_name == "fixed_point"sv) { 
+                return RouterEngine::FIXED_POINT_ALL_PAIRS; 
+            } else if (engine_name == "dijkstra"sv) { 
+                return RouterEngine::DIJKSTRA; 
+            } else if (engine_name == "cached_trees"sv) { 
+                return RouterEngine::SHORTEST_PATH_TREES; 
+            } else if (engine_name == "bidirectional_dijkstra"sv) { 
+                return RouterEngine::BIDIRECTIONAL_DIJKSTRA; 
+            } else if (engine_name == "a_star"sv) { 
+                return RouterEngine::A_STAR; 
+            } else if (engine_name == "landmarks"sv) { 
+                return RouterEngine::LANDMARKS; 
+            } else if (engine_name == "contraction_hierarchy"sv) { 
+                return RouterEngine::CONTRACTION_HIERARCHY; 
+            } else if (engine_name == "hub_labels"sv) { 
+                return RouterEngine::HUB_LABELS; 
+            } else if (engine_name == "route_patterns"sv) { 
+                return RouterEngine::ROUTE_PATTERNS; 
+            } else if (engine_name == "auto"sv) { 
+                return RouterEngine::AUTO; 
+            } 
+            throw ParsingError("Unexpected router engine \""s + engine_name + "\""s); 
+        } 
+
+        size_t InputStandardizer::StandardizeCount(const Node& count, std::string_view setting_name) { 
+            using namespace std::literals; 
+
+            const int value = count.AsInt(); 
+            if (value < 0) { 
+                throw ParsingError("Negative "s + std::string(setting_name) + " "s + std::to_string(value)); 
+            } 
+            return static_cast<size_t>(value); 
+        } 
+
         svg::Text::Offset InputStandardizer::StandardizeOffsetData(const Array& offset) { 
             using namespace std::literals; 
 
@@ -262,7 +368,7 @@ namespace json {
                             request_response.Key("total_time").Value(route_plan -> total_time);
 
                             auto items = request_response.Key("items"s).StartArray();
-                            for (const auto& item : route_plan -> items) {
+                            for (const auto item : route_plan -> items) {
                                 bool is_bus = item.span_count != 0;
                                 auto element = items.StartDict();
                                 element.Key("time").Value(item.weight);
@@ -272,7 +378,7 @@ namespace json {
                                            .Key("span_count"s).Value(item.span_count);
                                 } else {
                                     element.Key("type"s).Value("Wait"s)
-                                           .Key("stop_name"s).Value(item.name);
+                                           .Key("stop_name"s).Value(std::string(item.name));
                                 }
                                 element.EndDict();
                             }
@@ -282,6 +388,43 @@ namespace json {
                         } else {
                             request_response.Key("error_message"s).Value("not found"s);
                         }
+                    } else if (request -> type == "RouteMatrix"sv) {
+                        auto matrix_request = dynamic_cast<StatRequests::RouteMatrix*>(request.get());
+
+                        assert(matrix_request);
+
+                        //rows follow "from", columns follow "to", null where there is no route
+                        auto rows = request_response.Key("total_time"s).StartArray();
+                        for (const auto& row : handler.GetTimeMatrix(matrix_request -> from, matrix_request -> to)) {
+                            auto columns = rows.StartArray();
+                            for (const auto& total_time : row) {
+                                if (total_time) {
+                                    columns.Value(*total_time);
+                                } else {
+                                    columns.Value(nullptr);
+                                }
+                            }
+                            columns.EndArray();
+                        }
+                        rows.EndArray();
+                    } else if (request -> type == "Isochrone"sv) {
+                        auto isochrone_request = dynamic_cast<StatRequests::Isochrone*>(request.get());
+
+                        assert(isochrone_request);
+
+                        if (auto isochrone = handler.GetIsochrone(isochrone_request -> from, 
+                                                                  isochrone_request -> max_time)) {
+                            auto items = request_response.Key("items"s).StartArray();
+                            for (const auto& [stop_name, total_time] : *isochrone) {
+                                items.StartDict()
+                                     .Key("stop_name"s).Value(std::string(stop_name))
+                                     .Key("total_time"s).Value(total_time)
+                                     .EndDict();
+                            }
+                            items.EndArray();
+                        } else {
+                            request_response.Key("error_message"s).Value("not found"s);
+                        }
                     } else {
                         auto transport_request = static_cast<StatRequests::Transport*>(request.get());
                         assert(transport_request);
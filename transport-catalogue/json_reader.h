@@ -44,6 +44,9 @@ namespace json {
         private:
             static svg::Text::Offset StandardizeOffsetData(const Array& offset);
             static svg::Color StandardizeColorData(const Node& color_type);
+            static RouterEngine StandardizeRouterEngine(const std::string& engine_name);
+            //thread, landmark and cache counts of the routing settings, which cannot be negative
+            static size_t StandardizeCount(const Node& count, std::string_view setting_name);
         };
 
         struct Requests {
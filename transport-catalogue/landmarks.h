@@ -0,0 +1,166 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// ALT preprocessing: shortest weights from and to a few landmark vertexes. By the triangle
+// inequality d(v, t) >= d(L, t) - d(L, v) and d(v, t) >= d(v, L) - d(t, L), which gives a
+// consistent lower bound for A* that also reflects road distances and waits.
+template <typename Weight>
+class Landmarks {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    // Landmarks are picked among candidates (all vertexes when empty) farthest first
+    Landmarks(const Graph& graph, size_t landmark_count, const std::vector<VertexId>& candidates,
+              size_t thread_count = 1);
+
+    Weight GetLowerBound(VertexId vertex, VertexId target) const;
+    const std::vector<VertexId>& GetLandmarks() const;
+    //bytes held by the precomputed weights
+    size_t GetMemoryUsage() const;
+
+private:
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // Full single-source search; backward follows the edges against their direction
+    std::vector<Weight> ComputeWeights(VertexId source, bool backward) const;
+    void SelectLandmarks(size_t landmark_count, std::vector<VertexId> candidates);
+
+    const Weight* GetRow(const std::vector<Weight>& weights, size_t landmark) const {
+        return weights.data() + landmark * vertex_count_;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+                                            ? std::numeric_limits<Weight>::infinity()
+                                            : std::numeric_limits<Weight>::max();
+
+    const Graph& graph_;
+    const size_t vertex_count_;
+    std::vector<VertexId> landmarks_;
+    //landmark-major: [landmark * vertex_count + vertex]
+    std::vector<Weight> from_landmark_weights_;
+    std::vector<Weight> to_landmark_weights_;
+};
+
+template <typename Weight>
+Landmarks<Weight>::Landmarks(const Graph& graph, size_t landmark_count, const std::vector<VertexId>& candidates,
+                             size_t thread_count)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    std::vector<VertexId> all_candidates = candidates;
+    if (all_candidates.empty()) {
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            all_candidates.push_back(vertex);
+        }
+    }
+    SelectLandmarks(landmark_count, std::move(all_candidates));
+
+    to_landmark_weights_.resize(landmarks_.size() * vertex_count_);
+    parallel::ForEachIndex(landmarks_.size(), parallel::ResolveWorkerCount(thread_count), [&](size_t landmark) {
+        auto weights = ComputeWeights(landmarks_[landmark], true);
+        std::copy(weights.begin(), weights.end(), to_landmark_weights_.begin() + landmark * vertex_count_);
+    });
+}
+
+template <typename Weight>
+std::vector<Weight> Landmarks<Weight>::ComputeWeights(VertexId source, bool backward) const {
+    std::vector<Weight> weights(vertex_count_, INFINITE_WEIGHT);
+    PriorityQueue queue;
+    weights[source] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, source});
+
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > weights[vertex]) {
+            continue;
+        }
+        for (const auto& arc : backward ? graph_.GetIncomingArcs(vertex) : graph_.GetIncidentArcs(vertex)) {
+            if (const Weight candidate_weight = weight + arc.weight; candidate_weight < weights[arc.vertex]) {
+                weights[arc.vertex] = candidate_weight;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+    return weights;
+}
+
+// Farthest selection: every next landmark maximises the distance to the closest chosen one,
+// unreachable vertexes first, so separate networks get landmarks of their own
+template <typename Weight>
+void Landmarks<Weight>::SelectLandmarks(size_t landmark_count, std::vector<VertexId> candidates) {
+    landmark_count = std::min(landmark_count, candidates.size());
+    if (landmark_count == 0) {
+        return;
+    }
+
+    std::vector<Weight> closest_landmark_weights = ComputeWeights(candidates.front(), false);
+    while (landmarks_.size() < landmark_count) {
+        const auto farthest = std::max_element(candidates.begin(), candidates.end(), [&](VertexId lhs, VertexId rhs) {
+            return closest_landmark_weights[lhs] < closest_landmark_weights[rhs];
+        });
+        const VertexId landmark = *farthest;
+        candidates.erase(farthest);
+        landmarks_.push_back(landmark);
+
+        const auto weights = ComputeWeights(landmark, false);
+        from_landmark_weights_.insert(from_landmark_weights_.end(), weights.begin(), weights.end());
+        if (landmarks_.size() == 1) {
+            closest_landmark_weights = weights;
+        } else {
+            for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+                closest_landmark_weights[vertex] = std::min(closest_landmark_weights[vertex], weights[vertex]);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+Weight Landmarks<Weight>::GetLowerBound(VertexId vertex, VertexId target) const {
+    Weight bound = ZERO_WEIGHT;
+    for (size_t landmark = 0; landmark < landmarks_.size(); ++landmark) {
+        const Weight* from_landmark = GetRow(from_landmark_weights_, landmark);
+        if (from_landmark[vertex] != INFINITE_WEIGHT && from_landmark[target] != INFINITE_WEIGHT) {
+            bound = std::max(bound, from_landmark[target] - from_landmark[vertex]);
+        }
+        const Weight* to_landmark = GetRow(to_landmark_weights_, landmark);
+        if (to_landmark[vertex] != INFINITE_WEIGHT && to_landmark[target] != INFINITE_WEIGHT) {
+            bound = std::max(bound, to_landmark[vertex] - to_landmark[target]);
+        }
+    }
+    return bound;
+}
+
+template <typename Weight>
+const std::vector<VertexId>& Landmarks<Weight>::GetLandmarks() const {
+    return landmarks_;
+}
+
+template <typename Weight>
+size_t Landmarks<Weight>::GetMemoryUsage() const {
+    return (from_landmark_weights_.size() + to_landmark_weights_.size()) * sizeof(Weight);
+}
+
+}  // namespace graph
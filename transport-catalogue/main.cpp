@@ -28,5 +28,10 @@ int main() {
     
     json::output::PrintStats(handler, requests.stat_requests, std::cout);
 
+    if (requests.router_settings.report_route_cache_stats) {
+        const auto cache_stats = router.GetRouteCacheStats();
+        std::cerr << "route tree cache: "sv << cache_stats.hits << " hits, "sv << cache_stats.misses << " misses"sv << '\n';
+    }
+
     return 0;
 }
\ No newline at end of file
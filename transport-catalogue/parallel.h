@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+
+// 0 means "as many workers as the hardware supports"
+inline size_t ResolveWorkerCount(size_t requested) {
+    if (requested != 0) {
+        return requested;
+    }
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Half-open range [first, last) of the items a worker is responsible for
+struct Chunk {
+    size_t first;
+    size_t last;
+};
+
+inline Chunk GetChunk(size_t item_count, size_t worker, size_t worker_count) {
+    const size_t base = item_count / worker_count;
+    const size_t extra = item_count % worker_count;
+    const size_t first = worker * base + std::min(worker, extra);
+    return {first, first + base + (worker < extra ? 1 : 0)};
+}
+
+// Reusable barrier for a fixed group of workers (std::barrier is C++20)
+class Barrier {
+public:
+    explicit Barrier(size_t count)
+        : count_(count) {
+    }
+
+    void ArriveAndWait() {
+        std::unique_lock lock(mutex_);
+        const size_t generation = generation_;
+        if (++arrived_ == count_) {
+            arrived_ = 0;
+            ++generation_;
+            condition_.notify_all();
+            return;
+        }
+        condition_.wait(lock, [this, generation] { return generation != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    const size_t count_;
+    size_t arrived_ = 0;
+    size_t generation_ = 0;
+};
+
+// Runs task(worker, worker_count) on worker_count threads (the calling thread is worker 0)
+// and waits for all of them. The first exception thrown by a worker is rethrown.
+template <typename Task>
+void ForEachWorker(size_t worker_count, Task task) {
+    if (worker_count <= 1) {
+        task(size_t{0}, size_t{1});
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto guarded_task = [&](size_t worker) {
+        try {
+            task(worker, worker_count);
+        } catch (...) {
+            std::lock_guard lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count - 1);
+    for (size_t worker = 1; worker < worker_count; ++worker) {
+        threads.emplace_back(guarded_task, worker);
+    }
+    guarded_task(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Splits [0, item_count) into contiguous chunks and calls func(index) for every item
+template <typename Func>
+void ForEachIndex(size_t item_count, size_t worker_count, Func func) {
+    worker_count = std::max<size_t>(1, std::min(worker_count, item_count));
+    ForEachWorker(worker_count, [&](size_t worker, size_t workers) {
+        const auto [first, last] = GetChunk(item_count, worker, workers);
+        for (size_t index = first; index < last; ++index) {
+            func(index);
+        }
+    });
+}
+
+}  // namespace parallel
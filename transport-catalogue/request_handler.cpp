@@ -24,6 +24,15 @@ namespace catalogue {
             return router_.BuildRoute(from, to);
         }
 
+        router::TransportRouter::TimeMatrix RequestHandler::GetTimeMatrix(const std::vector<std::string>& from, 
+                                                                          const std::vector<std::string>& to) const {
+            return router_.BuildTimeMatrix(from, to);
+        }
+
+        std::optional<router::TransportRouter::Isochrone> RequestHandler::GetIsochrone(std::string_view from, double max_time) const {
+            return router_.BuildIsochrone(from, max_time);
+        }
+
         void RequestHandler::RenderMap(std::ostream& output) const {
             renderer_.RenderMap(database_.GetActiveStops(), database_.GetActiveRoutes(), output);
         }
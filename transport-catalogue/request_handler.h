@@ -19,6 +19,9 @@ namespace catalogue {
             domain::RouteStats GetRouteStats(std::string_view route_name) const;
             domain::StopStats GetStopStats(std::string_view stop_name) const;
             std::optional<router::TransportRouter::RoutePlan> GetRoutePlan(std::string_view from, std::string_view to) const;
+            router::TransportRouter::TimeMatrix GetTimeMatrix(const std::vector<std::string>& from, 
+                                                              const std::vector<std::string>& to) const;
+            std::optional<router::TransportRouter::Isochrone> GetIsochrone(std::string_view from, double max_time) const;
             void RenderMap(std::ostream& output) const;
 
         private:
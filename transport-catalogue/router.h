@@ -1,12 +1,16 @@
 #pragma once
 
 #include "graph.h"
+#include "parallel.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <optional>
+#include <queue>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
@@ -15,47 +19,70 @@
 namespace graph {
 
 template <typename Weight>
-class Router {
+struct RouteInfo {
+    Weight weight;
+    std::vector<EdgeId> edges;
+};
+
+// Common interface of every routing engine, so the owner can pick the engine at runtime
+template <typename Weight>
+class RouteBuilder {
+public:
+    virtual ~RouteBuilder() = default;
+    virtual std::optional<RouteInfo<Weight>> BuildRoute(VertexId from, VertexId to) const = 0;
+};
+
+// Precomputes all-pairs shortest paths (Floyd-Warshall) in the constructor.
+// No route leaves a weakly connected component, so every component gets a table of its own
+// and a query between two components is answered at once: the cubic build time and the
+// quadratic memory are summed over the components instead of taken over the whole graph.
+// With thread_count != 1 every relaxation step is split into row tiles handled by
+// a group of workers (0 means one worker per hardware thread).
+template <typename Weight>
+class Router : public RouteBuilder<Weight> {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    explicit Router(const Graph& graph, size_t thread_count = 1);
 
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
-    };
+    using RouteInfo = graph::RouteInfo<Weight>;
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+    // Repairs the tables after the weights of changed_edges changed in the graph or they were
+    // added to it (the vertexes stay the same). Every row is a shortest path tree of its own:
+    // the vertexes the row reached through a changed edge are cleared and re-derived from their
+    // incoming edges, then the improvements spread Dijkstra-like, so only the affected part
+    // of a row is visited. An edge joining two components rebuilds the tables.
+    void UpdateEdges(const std::vector<EdgeId>& changed_edges, size_t thread_count = 1);
 
 private:
     struct RouteInternalData {
         Weight weight;
         std::optional<EdgeId> prev_edge;
     };
+    //[from][to] by the positions of the vertexes in their component
     using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
 
-    void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
-            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                const auto& edge = graph.GetEdge(edge_id);
-                if (edge.weight < ZERO_WEIGHT) {
+    void InitializeRoutesInternalData(RoutesInternalData& routes_internal_data, const std::vector<VertexId>& component) {
+        routes_internal_data.assign(component.size(), std::vector<std::optional<RouteInternalData>>(component.size()));
+        for (VertexId position = 0; position < component.size(); ++position) {
+            routes_internal_data[position][position] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            for (const auto& arc : graph_.GetIncidentArcs(component[position])) {
+                if (arc.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                auto& route_internal_data = routes_internal_data[position][vertex_positions_[arc.vertex]];
+                if (!route_internal_data || route_internal_data->weight > arc.weight) {
+                    route_internal_data = RouteInternalData{arc.weight, arc.edge_id};
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
+    static void RelaxRoute(std::optional<RouteInternalData>& route_relaxing, const RouteInternalData& route_from,
+                           const RouteInternalData& route_to) {
         const Weight candidate_weight = route_from.weight + route_to.weight;
         if (!route_relaxing || candidate_weight < route_relaxing->weight) {
             route_relaxing = {candidate_weight,
@@ -63,41 +90,132 @@ private:
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
+    static void RelaxRoutesInternalDataThroughVertex(RoutesInternalData& routes_internal_data, VertexId vertex_through) {
+        RelaxRoutesInternalDataThroughVertex(routes_internal_data, 0, routes_internal_data.size(), vertex_through);
+    }
+
+    static void RelaxRoutesInternalDataThroughVertex(RoutesInternalData& routes_internal_data, VertexId vertex_from_first,
+                                                     VertexId vertex_from_last, VertexId vertex_through) {
+        const size_t vertex_count = routes_internal_data.size();
+        const auto& routes_through = routes_internal_data[vertex_through];
+        for (VertexId vertex_from = vertex_from_first; vertex_from < vertex_from_last; ++vertex_from) {
+            auto& routes_from = routes_internal_data[vertex_from];
+            if (const auto& route_from = routes_from[vertex_through]) {
                 for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+                    if (const auto& route_to = routes_through[vertex_to]) {
+                        RelaxRoute(routes_from[vertex_to], *route_from, *route_to);
                     }
                 }
             }
         }
     }
 
+    // The rows and the column of vertex_through never change during its own step
+    // (the diagonal is zero and weights are non-negative), so the rows of one step
+    // are independent and the result is identical to the single-threaded build.
+    static void RelaxRoutesInternalDataInParallel(RoutesInternalData& routes_internal_data, size_t thread_count) {
+        const size_t vertex_count = routes_internal_data.size();
+        thread_count = std::max<size_t>(1, std::min(thread_count, vertex_count));
+        parallel::Barrier barrier(thread_count);
+        parallel::ForEachWorker(thread_count, [&](size_t worker, size_t worker_count) {
+            const auto [first, last] = parallel::GetChunk(vertex_count, worker, worker_count);
+            for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
+                RelaxRoutesInternalDataThroughVertex(routes_internal_data, first, last, vertex_through);
+                barrier.ArriveAndWait();
+            }
+        });
+    }
+
+    // Labels the weakly connected components (edges followed both ways); the vertexes of a
+    // component keep their relative order, so its table is relaxed in the same order as before
+    void SplitIntoComponents();
+    void BuildTables(size_t thread_count);
+    void UpdateRow(VertexId vertex_from, const std::vector<EdgeId>& changed_edges, const std::vector<bool>& is_changed);
+
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    std::vector<size_t> vertex_components_;
+    std::vector<VertexId> vertex_positions_;
+    std::vector<std::vector<VertexId>> components_;
+    //one table per component
+    std::vector<RoutesInternalData> routes_internal_data_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, size_t thread_count)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
 {
-    InitializeRoutesInternalData(graph);
+    SplitIntoComponents();
+    BuildTables(thread_count);
+}
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+template <typename Weight>
+void Router<Weight>::SplitIntoComponents() {
+    static constexpr size_t NO_COMPONENT = std::numeric_limits<size_t>::max();
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    vertex_components_.assign(vertex_count, NO_COMPONENT);
+    size_t component_count = 0;
+    std::vector<VertexId> stack;
+    for (VertexId root = 0; root < vertex_count; ++root) {
+        if (vertex_components_[root] != NO_COMPONENT) {
+            continue;
+        }
+        vertex_components_[root] = component_count;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const VertexId vertex = stack.back();
+            stack.pop_back();
+            auto visit = [&](VertexId neighbor) {
+                if (vertex_components_[neighbor] == NO_COMPONENT) {
+                    vertex_components_[neighbor] = component_count;
+                    stack.push_back(neighbor);
+                }
+            };
+            for (const auto& arc : graph_.GetIncidentArcs(vertex)) {
+                visit(arc.vertex);
+            }
+            for (const auto& arc : graph_.GetIncomingArcs(vertex)) {
+                visit(arc.vertex);
+            }
+        }
+        ++component_count;
+    }
+
+    components_.assign(component_count, {});
+    vertex_positions_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        auto& component = components_[vertex_components_[vertex]];
+        vertex_positions_[vertex] = component.size();
+        component.push_back(vertex);
+    }
+}
+
+template <typename Weight>
+void Router<Weight>::BuildTables(size_t thread_count) {
+    thread_count = parallel::ResolveWorkerCount(thread_count);
+    routes_internal_data_.assign(components_.size(), {});
+    for (size_t component = 0; component < components_.size(); ++component) {
+        auto& routes_internal_data = routes_internal_data_[component];
+        InitializeRoutesInternalData(routes_internal_data, components_[component]);
+        if (thread_count > 1) {
+            RelaxRoutesInternalDataInParallel(routes_internal_data, thread_count);
+            continue;
+        }
+        for (VertexId vertex_through = 0; vertex_through < routes_internal_data.size(); ++vertex_through) {
+            RelaxRoutesInternalDataThroughVertex(routes_internal_data, vertex_through);
+        }
     }
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
+    if (vertex_components_.at(from) != vertex_components_.at(to)) {
+        return std::nullopt;
+    }
+    const auto& routes = routes_internal_data_[vertex_components_[from]][vertex_positions_[from]];
+    const auto& route_internal_data = routes[vertex_positions_[to]];
     if (!route_internal_data) {
         return std::nullopt;
     }
@@ -105,7 +223,7 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     std::vector<EdgeId> edges;
     for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
          edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+         edge_id = routes[vertex_positions_[graph_.GetEdge(*edge_id).from]]->prev_edge)
     {
         edges.push_back(*edge_id);
     }
@@ -114,4 +232,126 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(Ver
     return RouteInfo{weight, std::move(edges)};
 }
 
+template <typename Weight>
+void Router<Weight>::UpdateEdges(const std::vector<EdgeId>& changed_edges, size_t thread_count) {
+    std::vector<bool> is_changed(graph_.GetEdgeCount(), false);
+    bool joins_components = false;
+    for (const EdgeId edge_id : changed_edges) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        is_changed[edge_id] = true;
+        joins_components = joins_components || vertex_components_[edge.from] != vertex_components_[edge.to];
+    }
+    if (joins_components) {
+        SplitIntoComponents();
+        BuildTables(thread_count);
+        return;
+    }
+
+    parallel::ForEachIndex(graph_.GetVertexCount(), parallel::ResolveWorkerCount(thread_count), [&](size_t vertex_from) {
+        UpdateRow(vertex_from, changed_edges, is_changed);
+    });
+}
+
+template <typename Weight>
+void Router<Weight>::UpdateRow(VertexId vertex_from, const std::vector<EdgeId>& changed_edges,
+                               const std::vector<bool>& is_changed) {
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    //the row works with the positions of the vertexes in the component
+    const size_t component = vertex_components_[vertex_from];
+    const auto& vertexes = components_[component];
+    auto& routes = routes_internal_data_[component][vertex_positions_[vertex_from]];
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+
+    auto relax = [&](EdgeId edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (vertex_components_[edge.from] != component) {
+            return;
+        }
+        const auto& route_from = routes[vertex_positions_[edge.from]];
+        if (!route_from) {
+            return;
+        }
+        const Weight candidate_weight = route_from->weight + edge.weight;
+        if (auto& route_relaxing = routes[vertex_positions_[edge.to]]; !route_relaxing || candidate_weight < route_relaxing->weight) {
+            route_relaxing = RouteInternalData{candidate_weight, edge_id};
+            queue.push({candidate_weight, vertex_positions_[edge.to]});
+        }
+    };
+
+    const bool is_tree_changed = std::any_of(changed_edges.begin(), changed_edges.end(), [&](EdgeId edge_id) {
+        const VertexId vertex_to = graph_.GetEdge(edge_id).to;
+        if (vertex_components_[vertex_to] != component) {
+            return false;
+        }
+        const auto& route = routes[vertex_positions_[vertex_to]];
+        return route && route->prev_edge == edge_id;
+    });
+    if (is_tree_changed) {
+        enum class State : char { UNKNOWN, KEPT, CLEARED };
+        std::vector<State> states(routes.size(), State::UNKNOWN);
+        std::vector<VertexId> path;
+        std::vector<VertexId> cleared;
+        for (VertexId position = 0; position < routes.size(); ++position) {
+            if (!routes[position]) {
+                continue;
+            }
+            //climb the tree up to the root, a vertex already classified or a changed edge
+            VertexId ancestor = position;
+            while (states[ancestor] == State::UNKNOWN) {
+                const auto& prev_edge = routes[ancestor]->prev_edge;
+                if (!prev_edge || is_changed[*prev_edge]) {
+                    states[ancestor] = prev_edge ? State::CLEARED : State::KEPT;
+                    if (prev_edge) {
+                        cleared.push_back(ancestor);
+                    }
+                    break;
+                }
+                path.push_back(ancestor);
+                ancestor = vertex_positions_[graph_.GetEdge(*prev_edge).from];
+            }
+            for (const VertexId descendant : path) {
+                states[descendant] = states[ancestor];
+                if (states[ancestor] == State::CLEARED) {
+                    cleared.push_back(descendant);
+                }
+            }
+            path.clear();
+        }
+
+        for (const VertexId position : cleared) {
+            routes[position].reset();
+        }
+        for (const VertexId position : cleared) {
+            for (const EdgeId edge_id : graph_.GetIncomingEdges(vertexes[position])) {
+                relax(edge_id);
+            }
+        }
+    }
+    for (const EdgeId edge_id : changed_edges) {
+        relax(edge_id);
+    }
+
+    while (!queue.empty()) {
+        const auto [weight, position] = queue.top();
+        queue.pop();
+        if (weight > routes[position]->weight) {
+            continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertexes[position])) {
+            relax(edge_id);
+        }
+    }
+}
+
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,506 @@
+#include "router_snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace catalogue {
+    namespace router {
+        static_assert(std::numeric_limits<double>::is_iec559, "the snapshot stores IEEE 754 doubles");
+
+        namespace detail {
+            //FNV-1a over 64-bit words (the tail is padded with zeros), fed in pieces of any size
+            class Hasher {
+            public:
+                void Add(const void* data, size_t size) {
+                    auto bytes = static_cast<const char*>(data);
+                    if (carry_size_ > 0) {
+                        const size_t taken = std::min(WORD_SIZE - carry_size_, size);
+                        std::memcpy(carry_ + carry_size_, bytes, taken);
+                        carry_size_ += taken;
+                        bytes += taken;
+                        size -= taken;
+                        if (carry_size_ < WORD_SIZE) {
+                            return;
+                        }
+                        Mix(carry_);
+                        carry_size_ = 0;
+                    }
+                    for (; size >= WORD_SIZE; bytes += WORD_SIZE, size -= WORD_SIZE) {
+                        Mix(bytes);
+                    }
+                    std::memcpy(carry_, bytes, size);
+                    carry_size_ = size;
+                }
+
+                template <typename Value>
+                void AddValue(const Value& value) {
+                    Add(&value, sizeof(value));
+                }
+
+                void AddString(std::string_view value) {
+                    Add(value.data(), value.size());
+                    Add("", 1);
+                }
+
+                std::uint64_t Get() const {
+                    Hasher result = *this;
+                    if (carry_size_ > 0) {
+                        std::memset(result.carry_ + carry_size_, 0, WORD_SIZE - carry_size_);
+                        result.Mix(result.carry_);
+                    }
+                    return result.hash_;
+                }
+
+            private:
+                static constexpr size_t WORD_SIZE = sizeof(std::uint64_t);
+                static constexpr std::uint64_t OFFSET_BASIS = 14695981039346656037ull;
+                static constexpr std::uint64_t PRIME = 1099511628211ull;
+
+                void Mix(const char* bytes) {
+                    std::uint64_t word;
+                    std::memcpy(&word, bytes, WORD_SIZE);
+                    hash_ = (hash_ ^ word) * PRIME;
+                }
+
+                std::uint64_t hash_ = OFFSET_BASIS;
+                char carry_[WORD_SIZE] = {};
+                size_t carry_size_ = 0;
+            };
+
+            //writes the sections after the header, hashing them on the way
+            class SectionWriter {
+            public:
+                explicit SectionWriter(std::ofstream& output)
+                : output_(output)
+                {
+                }
+
+                void Write(const void* data, size_t size) {
+                    output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                    hasher_.Add(data, size);
+                    size_ += size;
+                }
+
+                template <typename Value>
+                void WriteValue(const Value& value) {
+                    Write(&value, sizeof(value));
+                }
+
+                //every section starts at a multiple of 8 bytes
+                void Align() {
+                    static const char ZEROS[8] = {};
+                    Write(ZEROS, (sizeof(ZEROS) - size_ % sizeof(ZEROS)) % sizeof(ZEROS));
+                }
+
+                //the checksum of what was written since the previous call
+                std::uint64_t TakeChecksum() {
+                    const std::uint64_t checksum = hasher_.Get();
+                    hasher_ = Hasher{};
+                    return checksum;
+                }
+
+            private:
+                std::ofstream& output_;
+                Hasher hasher_;
+                size_t size_ = 0;
+            };
+
+            template <typename Names>
+            void WriteNames(SectionWriter& writer, const Names& names) {
+                std::uint64_t offset = 0;
+                writer.WriteValue(offset);
+                for (std::string_view name : names) {
+                    offset += name.size();
+                    writer.WriteValue(offset);
+                }
+                writer.Align();
+                for (std::string_view name : names) {
+                    writer.Write(name.data(), name.size());
+                }
+                writer.Align();
+            }
+        } //namespace detail
+
+        // MappedFile member functions definition
+
+        MappedFile::MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+            if (const int descriptor = ::open(path.c_str(), O_RDONLY); descriptor >= 0) {
+                struct stat status;
+                if (::fstat(descriptor, &status) == 0 && status.st_size > 0) {
+                    void* mapping = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+                    if (mapping != MAP_FAILED) {
+                        data_ = static_cast<const char*>(mapping);
+                        size_ = static_cast<size_t>(status.st_size);
+                        is_mapped_ = true;
+                    }
+                }
+                ::close(descriptor);
+            }
+            if (is_mapped_) {
+                return;
+            }
+#endif
+            std::ifstream input(path, std::ios::binary);
+            if (!input) {
+                return;
+            }
+            buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            if (!buffer_.empty()) {
+                data_ = buffer_.data();
+                size_ = buffer_.size();
+            }
+        }
+
+        MappedFile::~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+            if (is_mapped_) {
+                ::munmap(const_cast<char*>(data_), size_);
+            }
+#endif
+        }
+
+        bool MappedFile::IsOpen() const {
+            return data_ != nullptr;
+        }
+
+        const char* MappedFile::GetData() const {
+            return data_;
+        }
+
+        size_t MappedFile::GetSize() const {
+            return size_;
+        }
+
+        // RouterSnapshot member functions definition
+
+        std::uint64_t RouterSnapshot::ComputeFingerprint(const database::TransportCatalogue& database,
+                                                         const domain::RouterSettings& settings) {
+            detail::Hasher hasher;
+            hasher.AddValue(settings.bus_wait_time);
+            hasher.AddValue(settings.bus_velocity);
+            hasher.AddValue(settings.prune_dominated_edges);
+            hasher.AddValue(settings.single_vertex_per_stop);
+
+            //the buses in a fixed order, with every distance their rides are made of
+            auto buses = database.GetActiveRoutes();
+            std::sort(buses.begin(), buses.end(), [](const domain::RoutePtr& lhs, const domain::RoutePtr& rhs) {
+                return lhs -> name < rhs -> name;
+            });
+            for (const auto& bus : buses) {
+                hasher.AddString(bus -> name);
+                hasher.AddValue(bus -> is_roundtrip);
+                hasher.AddValue(static_cast<std::uint64_t>(bus -> stops.size()));
+                for (size_t index = 0; index < bus -> stops.size(); index++) {
+                    hasher.AddString(bus -> stops[index] -> name);
+                    if (index > 0) {
+                        const auto& prev_stop = bus -> stops[index - 1] -> name;
+                        hasher.AddValue(database.GetDistance(prev_stop, bus -> stops[index] -> name));
+                        if (!(bus -> is_roundtrip)) {
+                            hasher.AddValue(database.GetDistance(bus -> stops[index] -> name, prev_stop));
+                        }
+                    }
+                }
+            }
+            return hasher.Get();
+        }
+
+        bool RouterSnapshot::Write(const std::string& path, std::uint64_t fingerprint, const Graph& graph,
+                                   size_t pruned_edge_count, const BusEdges& bus_edges, const Table& table) {
+            if (!IsLittleEndianHost() || graph.GetEdgeCount() >= Table::NO_EDGE) {
+                return false;
+            }
+
+            const size_t vertex_count = graph.GetVertexCount();
+            const size_t stop_count = graph.DoubleToSingleVertexPos(vertex_count);
+            std::vector<std::string_view> stopnames;
+            stopnames.reserve(stop_count);
+            for (size_t stop = 0; stop < stop_count; stop++) {
+                stopnames.push_back((*graph.GetVertex(graph.SingleToDoubleVertexPos(stop))) -> name);
+            }
+
+            std::unordered_map<std::string_view, std::uint32_t> busname_to_id;
+            std::vector<std::string_view> busnames;
+            auto intern = [&](std::string_view busname) {
+                auto [iter, inserted] = busname_to_id.emplace(busname, static_cast<std::uint32_t>(busnames.size()));
+                if (inserted) {
+                    busnames.push_back(busname);
+                }
+                return iter -> second;
+            };
+            for (const auto& [busname, edge_ids] : bus_edges) {
+                intern(busname);
+            }
+            std::vector<Edge> edges(graph.GetEdgeCount());
+            for (graph::EdgeId edge_id = 0; edge_id < edges.size(); edge_id++) {
+                const auto& edge = graph.GetEdge(edge_id);
+                const auto& edge_path = graph.GetEdgePath(edge_id);
+                edges[edge_id] = Edge{static_cast<std::uint32_t>(edge.from), static_cast<std::uint32_t>(edge.to), edge.weight,
+                                      intern(edge_path.path_name), edge_path.span_count};
+            }
+
+            Header header{};
+            std::copy(std::begin(MAGIC), std::end(MAGIC), header.magic);
+            header.version = VERSION;
+            header.flags = graph.GetFoldedWait() ? FOLDED_WAIT_FLAG : 0;
+            header.fingerprint = fingerprint;
+            header.vertex_count = vertex_count;
+            header.edge_count = edges.size();
+            header.stop_count = stop_count;
+            header.bus_count = busnames.size();
+            for (auto stopname : stopnames) {
+                header.stop_names_size += stopname.size();
+            }
+            for (auto busname : busnames) {
+                header.bus_names_size += busname.size();
+                if (auto iter = bus_edges.find(busname); iter != bus_edges.end()) {
+                    header.bus_edges_size += iter -> second.size();
+                }
+            }
+            header.pruned_edge_count = pruned_edge_count;
+            header.folded_wait = graph.GetFoldedWait().value_or(0);
+
+            const std::string temporary_path = MakeTemporaryPath(path);
+            {
+                std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+                if (!output) {
+                    return false;
+                }
+                output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+                detail::SectionWriter writer(output);
+                detail::WriteNames(writer, stopnames);
+                detail::WriteNames(writer, busnames);
+                writer.Write(edges.data(), edges.size() * sizeof(Edge));
+                writer.Align();
+
+                std::uint64_t offset = 0;
+                writer.WriteValue(offset);
+                for (auto busname : busnames) {
+                    if (auto iter = bus_edges.find(busname); iter != bus_edges.end()) {
+                        offset += iter -> second.size();
+                    }
+                    writer.WriteValue(offset);
+                }
+                for (auto busname : busnames) {
+                    if (auto iter = bus_edges.find(busname); iter != bus_edges.end()) {
+                        for (const auto edge_id : iter -> second) {
+                            writer.WriteValue(static_cast<std::uint32_t>(edge_id));
+                        }
+                    }
+                }
+                writer.Align();
+                const std::uint64_t sections_checksum = writer.TakeChecksum();
+
+                writer.Write(table.GetWeights(), vertex_count * vertex_count * sizeof(Time));
+                writer.Write(table.GetPrevEdges(), vertex_count * vertex_count * sizeof(Table::CompactEdgeId));
+                writer.Align();
+
+                header.graph_checksum = ComputeGraphChecksum(header, sections_checksum);
+                output.seekp(0);
+                output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                if (!output.flush()) {
+                    std::remove(temporary_path.c_str());
+                    return false;
+                }
+            }
+            if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+                std::remove(temporary_path.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        std::unique_ptr<RouterSnapshot> RouterSnapshot::Open(const std::string& path, std::uint64_t fingerprint,
+                                                             const database::TransportCatalogue& database) {
+            if (!IsLittleEndianHost()) {
+                return nullptr;
+            }
+            auto file = std::make_unique<MappedFile>(path);
+            if (!file -> IsOpen() || file -> GetSize() < sizeof(Header)) {
+                return nullptr;
+            }
+            Header header;
+            std::memcpy(&header, file -> GetData(), sizeof(header));
+            if (!std::equal(std::begin(MAGIC), std::end(MAGIC), header.magic) || header.version != VERSION
+                || header.fingerprint != fingerprint) {
+                return nullptr;
+            }
+
+            //no count can exceed the file size, which also keeps the layout arithmetic from overflowing
+            const std::uint64_t limit = file -> GetSize();
+            const std::uint64_t vertexes_per_stop = header.flags & FOLDED_WAIT_FLAG ? 1 : 2;
+            if (header.vertex_count > limit || (header.vertex_count > 0 && header.vertex_count > limit / header.vertex_count)
+                || header.edge_count > limit || header.stop_count > limit || header.bus_count > limit
+                || header.stop_names_size > limit || header.bus_names_size > limit || header.bus_edges_size > limit
+                || header.vertex_count != header.stop_count * vertexes_per_stop) {
+                return nullptr;
+            }
+            const Layout layout = MakeLayout(header);
+            if (layout.size != file -> GetSize()) {
+                return nullptr;
+            }
+            //the table sections are left unread, their pages are faulted in by the queries only
+            detail::Hasher hasher;
+            hasher.Add(file -> GetData() + sizeof(Header), layout.weights - sizeof(Header));
+            if (ComputeGraphChecksum(header, hasher.Get()) != header.graph_checksum) {
+                return nullptr;
+            }
+
+            std::unique_ptr<RouterSnapshot> snapshot(new RouterSnapshot(std::move(file)));
+            snapshot -> header_ = header;
+            snapshot -> layout_ = layout;
+
+            //names are resolved in the database, the graph refers to its stops and buses
+            auto read_names = [&snapshot](size_t offsets_offset, size_t names_offset, std::uint64_t count,
+                                          std::uint64_t names_size, auto resolve) {
+                const auto offsets = snapshot -> GetSection<std::uint64_t>(offsets_offset);
+                const auto names = snapshot -> GetSection<char>(names_offset);
+                for (std::uint64_t index = 0; index < count; index++) {
+                    if (offsets[index] > offsets[index + 1] || offsets[index + 1] > names_size
+                        || !resolve(std::string_view(names + offsets[index], offsets[index + 1] - offsets[index]))) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            const bool are_names_resolved =
+                read_names(layout.stop_offsets, layout.stop_names, header.stop_count, header.stop_names_size, [&](std::string_view stopname) {
+                    auto stop = database.FindStop(stopname);
+                    snapshot -> stops_.push_back(stop);
+                    return stop != nullptr;
+                }) &&
+                read_names(layout.bus_offsets, layout.bus_names, header.bus_count, header.bus_names_size, [&](std::string_view busname) {
+                    auto bus = database.FindRoute(busname);
+                    if (bus) {
+                        snapshot -> busnames_.push_back(bus -> name);
+                    }
+                    return bus != nullptr;
+                });
+            if (!are_names_resolved) {
+                return nullptr;
+            }
+
+            const auto edges = snapshot -> GetSection<Edge>(layout.edges);
+            for (std::uint64_t edge_id = 0; edge_id < header.edge_count; edge_id++) {
+                const Edge& edge = edges[edge_id];
+                if (edge.from >= header.vertex_count || edge.to >= header.vertex_count || edge.bus >= header.bus_count) {
+                    return nullptr;
+                }
+            }
+            const auto bus_edge_offsets = snapshot -> GetSection<std::uint64_t>(layout.bus_edge_offsets);
+            const auto bus_edges = snapshot -> GetSection<std::uint32_t>(layout.bus_edges);
+            for (std::uint64_t bus = 0; bus < header.bus_count; bus++) {
+                if (bus_edge_offsets[bus] > bus_edge_offsets[bus + 1]) {
+                    return nullptr;
+                }
+            }
+            if (bus_edge_offsets[0] != 0 || bus_edge_offsets[header.bus_count] != header.bus_edges_size
+                || std::any_of(bus_edges, bus_edges + header.bus_edges_size, [&header](std::uint32_t edge_id) {
+                       return edge_id >= header.edge_count;
+                   })) {
+                return nullptr;
+            }
+            return snapshot;
+        }
+
+        RouterSnapshot::Graph RouterSnapshot::MakeGraph() const {
+            Graph graph(stops_, header_.flags & FOLDED_WAIT_FLAG ? std::optional<Time>(header_.folded_wait) : std::nullopt);
+            const auto edges = GetSection<Edge>(layout_.edges);
+            for (std::uint64_t edge_id = 0; edge_id < header_.edge_count; edge_id++) {
+                const Edge& edge = edges[edge_id];
+                graph.SetEdgePath(graph.AddEdge({edge.from, edge.to, edge.weight}), {busnames_[edge.bus], edge.span_count});
+            }
+            return graph;
+        }
+
+        RouterSnapshot::BusEdges RouterSnapshot::MakeBusEdges() const {
+            BusEdges bus_edges;
+            const auto offsets = GetSection<std::uint64_t>(layout_.bus_edge_offsets);
+            const auto edge_ids = GetSection<std::uint32_t>(layout_.bus_edges);
+            for (std::uint64_t bus = 0; bus < header_.bus_count; bus++) {
+                if (offsets[bus] < offsets[bus + 1]) {
+                    bus_edges[busnames_[bus]].assign(edge_ids + offsets[bus], edge_ids + offsets[bus + 1]);
+                }
+            }
+            return bus_edges;
+        }
+
+        size_t RouterSnapshot::GetPrunedEdgeCount() const {
+            return header_.pruned_edge_count;
+        }
+
+        const RouterSnapshot::Time* RouterSnapshot::GetWeights() const {
+            return GetSection<Time>(layout_.weights);
+        }
+
+        const RouterSnapshot::Table::CompactEdgeId* RouterSnapshot::GetPrevEdges() const {
+            return GetSection<Table::CompactEdgeId>(layout_.prev_edges);
+        }
+
+        //private class member functions
+        RouterSnapshot::RouterSnapshot(std::unique_ptr<MappedFile> file)
+        : file_(std::move(file))
+        {
+        }
+
+        RouterSnapshot::Layout RouterSnapshot::MakeLayout(const Header& header) {
+            static_assert(sizeof(Edge) == 24, "edges are stored without padding");
+            size_t offset = sizeof(Header);
+            auto take = [&offset](size_t size) {
+                const size_t section = offset;
+                offset += (size + 7) / 8 * 8;
+                return section;
+            };
+
+            Layout layout;
+            layout.stop_offsets = take((header.stop_count + 1) * sizeof(std::uint64_t));
+            layout.stop_names = take(header.stop_names_size);
+            layout.bus_offsets = take((header.bus_count + 1) * sizeof(std::uint64_t));
+            layout.bus_names = take(header.bus_names_size);
+            layout.edges = take(header.edge_count * sizeof(Edge));
+            layout.bus_edge_offsets = take((header.bus_count + 1) * sizeof(std::uint64_t));
+            layout.bus_edges = take(header.bus_edges_size * sizeof(std::uint32_t));
+            layout.weights = take(header.vertex_count * header.vertex_count * sizeof(Time));
+            layout.prev_edges = take(header.vertex_count * header.vertex_count * sizeof(Table::CompactEdgeId));
+            layout.size = offset;
+            return layout;
+        }
+
+        std::uint64_t RouterSnapshot::ComputeGraphChecksum(Header header, std::uint64_t sections_checksum) {
+            header.graph_checksum = 0;
+            detail::Hasher hasher;
+            hasher.AddValue(header);
+            hasher.AddValue(sections_checksum);
+            return hasher.Get();
+        }
+
+        std::string RouterSnapshot::MakeTemporaryPath(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+            return path + ".tmp." + std::to_string(::getpid());
+#else
+            return path + ".tmp." + std::to_string(std::random_device{}());
+#endif
+        }
+
+        bool RouterSnapshot::IsLittleEndianHost() {
+            const std::uint16_t probe = 1;
+            char first_byte;
+            std::memcpy(&first_byte, &probe, 1);
+            return first_byte == 1;
+        }
+    } //namespace router
+} //namespace catalogue
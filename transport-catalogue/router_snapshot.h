@@ -0,0 +1,144 @@
+#pragma once
+
+#include "graph.h"
+#include "compact_router.h"
+#include "domain.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace catalogue {
+    namespace router {
+
+        //read-only contents of a file: memory-mapped where the platform allows it, so the pages
+        //are shared between processes, read into memory otherwise
+        class MappedFile {
+        public:
+            explicit MappedFile(const std::string& path);
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            ~MappedFile();
+
+            bool IsOpen() const;
+            const char* GetData() const;
+            size_t GetSize() const;
+
+        private:
+            const char* data_ = nullptr;
+            size_t size_ = 0;
+            bool is_mapped_ = false;
+            std::vector<char> buffer_;
+        };
+
+        /*
+        The built routing graph and all-pairs table saved to a file, so the next start only maps it.
+        Every number is little-endian and every section starts at a multiple of 8 bytes, so the
+        table is used in place straight from the mapping:
+            header
+            stop names    u64 offsets[stop_count + 1], chars         (in vertex order)
+            bus names     u64 offsets[bus_count + 1], chars
+            edges         Edge[edge_count]
+            bus edges     u64 offsets[bus_count + 1], u32 edge ids    (the ride edges of every bus)
+            weights       f64[vertex_count * vertex_count]            (+inf where there is no route)
+            prev edges    u32[vertex_count * vertex_count]            (0xFFFFFFFF where there is none)
+        The graph checksum covers the header and the sections up to the table and is verified on
+        every start. The table is not hashed, since that would read every page of the mapping:
+        the CompactRouter answering from it checks the predecessor edges of every route it walks.
+        The fingerprint identifies the catalogue data and the routing settings the snapshot was
+        built from.
+        */
+        class RouterSnapshot {
+        public:
+            using Time = double;
+            using Graph = graph::DoubleVertexGraph<Time, domain::StopPtr>;
+            using Table = graph::CompactRouter<Time>;
+            using BusEdges = std::unordered_map<std::string_view, std::vector<graph::EdgeId>>;
+
+            static std::uint64_t ComputeFingerprint(const database::TransportCatalogue& database,
+                                                    const domain::RouterSettings& settings);
+            //written to a temporary file of this process next to the path and renamed,
+            //so a concurrent start never maps half a file
+            static bool Write(const std::string& path, std::uint64_t fingerprint, const Graph& graph,
+                              size_t pruned_edge_count, const BusEdges& bus_edges, const Table& table);
+            //nullptr when the file is missing, of another version, built from other data or its
+            //header, names or edges are corrupted; the table pages are not read
+            static std::unique_ptr<RouterSnapshot> Open(const std::string& path, std::uint64_t fingerprint,
+                                                        const database::TransportCatalogue& database);
+
+            //stops and bus names refer to the database the snapshot was opened with
+            Graph MakeGraph() const;
+            BusEdges MakeBusEdges() const;
+            size_t GetPrunedEdgeCount() const;
+            const Time* GetWeights() const;
+            const Table::CompactEdgeId* GetPrevEdges() const;
+
+        private:
+            static constexpr char MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', '\0'};
+            static constexpr std::uint32_t VERSION = 3;
+            static constexpr std::uint32_t FOLDED_WAIT_FLAG = 1;
+
+            struct Header {
+                char magic[8];
+                std::uint32_t version;
+                std::uint32_t flags;
+                std::uint64_t fingerprint;
+                std::uint64_t graph_checksum;
+                std::uint64_t vertex_count;
+                std::uint64_t edge_count;
+                std::uint64_t stop_count;
+                std::uint64_t bus_count;
+                std::uint64_t stop_names_size;
+                std::uint64_t bus_names_size;
+                std::uint64_t bus_edges_size;
+                std::uint64_t pruned_edge_count;
+                double folded_wait;
+            };
+
+            struct Edge {
+                std::uint32_t from;
+                std::uint32_t to;
+                double weight;
+                std::uint32_t bus;
+                std::int32_t span_count;
+            };
+
+            //byte offsets of the sections, all derived from the header counts
+            struct Layout {
+                size_t stop_offsets;
+                size_t stop_names;
+                size_t bus_offsets;
+                size_t bus_names;
+                size_t edges;
+                size_t bus_edge_offsets;
+                size_t bus_edges;
+                size_t weights;
+                size_t prev_edges;
+                size_t size;
+            };
+
+            explicit RouterSnapshot(std::unique_ptr<MappedFile> file);
+
+            static Layout MakeLayout(const Header& header);
+            //the header (without the graph checksum itself) and the checksum of the sections before the table
+            static std::uint64_t ComputeGraphChecksum(Header header, std::uint64_t sections_checksum);
+            static std::string MakeTemporaryPath(const std::string& path);
+            static bool IsLittleEndianHost();
+
+            template <typename T>
+            const T* GetSection(size_t offset) const {
+                return reinterpret_cast<const T*>(file_ -> GetData() + offset);
+            }
+
+            std::unique_ptr<MappedFile> file_;
+            Header header_;
+            Layout layout_;
+            std::vector<domain::StopPtr> stops_;
+            std::vector<std::string_view> busnames_;
+        };
+    } //namespace router
+} //namespace catalogue
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Keeps the full shortest path trees of the most recently used origins (LRU, at most
+// capacity trees). The first query from an origin grows its whole tree with Dijkstra,
+// every later query from it is a walk over the cached predecessor array.
+// Safe to query from several threads.
+template <typename Weight>
+class ShortestPathTreeCache : public RouteBuilder<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    ShortestPathTreeCache(const Graph& graph, size_t capacity);
+
+    using RouteInfo = graph::RouteInfo<Weight>;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    Stats GetStats() const;
+
+private:
+    struct Tree {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+    };
+    using TreePtr = std::shared_ptr<const Tree>;
+    using RecentTrees = std::list<std::pair<VertexId, TreePtr>>;
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+    using PriorityQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    TreePtr GetTree(VertexId from) const;
+    TreePtr ComputeTree(VertexId from) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr Weight INFINITE_WEIGHT = std::numeric_limits<Weight>::has_infinity
+                                            ? std::numeric_limits<Weight>::infinity()
+                                            : std::numeric_limits<Weight>::max();
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+    const Graph& graph_;
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    //most recently used first
+    mutable RecentTrees recent_trees_;
+    mutable std::unordered_map<VertexId, typename RecentTrees::iterator> origin_to_tree_;
+    mutable Stats stats_;
+};
+
+template <typename Weight>
+ShortestPathTreeCache<Weight>::ShortestPathTreeCache(const Graph& graph, size_t capacity)
+    : graph_(graph)
+    , capacity_(std::max<size_t>(1, capacity))
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+typename ShortestPathTreeCache<Weight>::Stats ShortestPathTreeCache<Weight>::GetStats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+template <typename Weight>
+typename ShortestPathTreeCache<Weight>::TreePtr ShortestPathTreeCache<Weight>::GetTree(VertexId from) const {
+    {
+        std::lock_guard lock(mutex_);
+        if (auto iter = origin_to_tree_.find(from); iter != origin_to_tree_.end()) {
+            ++stats_.hits;
+            recent_trees_.splice(recent_trees_.begin(), recent_trees_, iter -> second);
+            return iter -> second -> second;
+        }
+        ++stats_.misses;
+    }
+
+    //grown without the lock, so other origins can be answered meanwhile
+    TreePtr tree = ComputeTree(from);
+
+    std::lock_guard lock(mutex_);
+    if (origin_to_tree_.count(from) == 0) {
+        recent_trees_.emplace_front(from, tree);
+        origin_to_tree_[from] = recent_trees_.begin();
+        if (recent_trees_.size() > capacity_) {
+            origin_to_tree_.erase(recent_trees_.back().first);
+            recent_trees_.pop_back();
+        }
+    }
+    return tree;
+}
+
+template <typename Weight>
+typename ShortestPathTreeCache<Weight>::TreePtr ShortestPathTreeCache<Weight>::ComputeTree(VertexId from) const {
+    auto tree = std::make_shared<Tree>();
+    tree -> weights.assign(graph_.GetVertexCount(), INFINITE_WEIGHT);
+    tree -> prev_edges.assign(graph_.GetVertexCount(), NO_EDGE);
+
+    PriorityQueue queue;
+    tree -> weights[from] = ZERO_WEIGHT;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (weight > tree -> weights[vertex]) {
+            continue;
+        }
+        for (const auto& arc : graph_.GetIncidentArcs(vertex)) {
+            if (const Weight candidate_weight = weight + arc.weight; candidate_weight < tree -> weights[arc.vertex]) {
+                tree -> weights[arc.vertex] = candidate_weight;
+                tree -> prev_edges[arc.vertex] = arc.edge_id;
+                queue.push({candidate_weight, arc.vertex});
+            }
+        }
+    }
+    return tree;
+}
+
+template <typename Weight>
+std::optional<typename ShortestPathTreeCache<Weight>::RouteInfo>
+ShortestPathTreeCache<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const TreePtr tree = GetTree(from);
+    if (tree -> weights[to] == INFINITE_WEIGHT) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = tree -> prev_edges[to]; edge_id != NO_EDGE; edge_id = tree -> prev_edges[graph_.GetEdge(edge_id).from]) {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{tree -> weights[to], std::move(edges)};
+}
+
+}  // namespace graph
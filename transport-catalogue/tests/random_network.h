@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../transport_catalogue.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace tests {
+    //stops at random coordinates, buses riding random sequences of them with random distances
+    class RandomNetwork {
+    public:
+        RandomNetwork(unsigned seed, size_t stop_count)
+        : generator_(seed) {
+            for (size_t index = 0; index < stop_count; index++) {
+                stopnames_.push_back("Stop " + std::to_string(index));
+                database_.AddStop(stopnames_.back(), {55.5 + Random(0, 100) / 1000.0, 37.5 + Random(0, 100) / 1000.0});
+            }
+        }
+
+        //a bus of stop_count stops drawn from [first_stop, last_stop)
+        void AddBus(const std::string& busname, size_t stop_count, bool is_roundtrip,
+                    size_t first_stop = 0, size_t last_stop = 0) {
+            if (last_stop == 0) {
+                last_stop = stopnames_.size();
+            }
+            std::vector<std::string> stops;
+            while (stops.size() < stop_count) {
+                const auto& stopname = stopnames_[Random(first_stop, last_stop - 1)];
+                if (stops.empty() || stops.back() != stopname) {
+                    stops.push_back(stopname);
+                }
+            }
+            if (is_roundtrip) {
+                stops.push_back(stops.front());
+            }
+            for (size_t index = 1; index < stops.size(); index++) {
+                SetRandomDistance(stops[index - 1], stops[index]);
+                if (!is_roundtrip) {
+                    SetRandomDistance(stops[index], stops[index - 1]);
+                }
+            }
+            database_.AddRoute(busname, stops, is_roundtrip);
+        }
+
+        void SetRandomDistance(const std::string& from, const std::string& to) {
+            database_.SetDistance(from, to, static_cast<int>(Random(200, 5000)));
+        }
+
+        size_t Random(size_t min, size_t max) {
+            return std::uniform_int_distribution<size_t>(min, max)(generator_);
+        }
+
+        catalogue::database::TransportCatalogue& GetDatabase() {
+            return database_;
+        }
+
+        const std::vector<std::string>& GetStopnames() const {
+            return stopnames_;
+        }
+
+    private:
+        std::mt19937 generator_;
+        catalogue::database::TransportCatalogue database_;
+        std::vector<std::string> stopnames_;
+    };
+
+} //namespace tests
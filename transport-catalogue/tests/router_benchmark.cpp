@@ -0,0 +1,65 @@
+/*
+Preprocessing and query times of the router engines on a large random network, built like the tests
+(the defaults take under a minute, mostly the all-pairs table and the Dijkstra queries):
+    g++ -std=c++17 -O2 -pthread -I.. router_benchmark.cpp $(ls ../*.cpp | grep -v main.cpp) -o router_benchmark
+    ./router_benchmark [stop_count] [query_count]
+*/
+#include "random_network.h"
+#include "../transport_router.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+using catalogue::domain::RouterEngine;
+using catalogue::domain::RouterSettings;
+using catalogue::router::TransportRouter;
+
+int main(int argc, char* argv[]) {
+    using Clock = std::chrono::steady_clock;
+
+    const size_t stop_count = argc > 1 ? std::stoul(argv[1]) : 1200;
+    const size_t query_count = argc > 2 ? std::stoul(argv[2]) : 100000;
+    static const size_t NEIGHBOURHOOD_SIZE = 48;
+    if (stop_count <= NEIGHBOURHOOD_SIZE) {
+        std::cerr << "The network needs more than "s << NEIGHBOURHOOD_SIZE << " stops\n"s;
+        return 1;
+    }
+    //a bus every eight stops, each of 16 stops, half of them roundtrips. Like city buses, each one
+    //serves a neighbourhood: 48 consecutive stops, shifted by eight stops from the previous bus
+    tests::RandomNetwork network(42, stop_count);
+    for (size_t bus = 0; bus < stop_count / 8; bus++) {
+        const size_t first_stop = bus * 8 % (stop_count - NEIGHBOURHOOD_SIZE);
+        network.AddBus("Bus "s + std::to_string(bus), 16, bus % 2 == 0, first_stop, first_stop + NEIGHBOURHOOD_SIZE);
+    }
+    std::vector<std::pair<std::string, std::string>> queries;
+    for (size_t query = 0; query < query_count; query++) {
+        queries.emplace_back(network.GetStopnames()[network.Random(0, stop_count - 1)],
+                             network.GetStopnames()[network.Random(0, stop_count - 1)]);
+    }
+
+    const std::vector<std::pair<std::string, RouterEngine>> engines = {
+        {"all_pairs"s, RouterEngine::ALL_PAIRS}, {"dijkstra"s, RouterEngine::DIJKSTRA},
+        {"contraction_hierarchy"s, RouterEngine::CONTRACTION_HIERARCHY},
+    };
+    std::cout << stop_count << " stops, "s << stop_count / 8 << " buses, "s << query_count << " Route queries\n"s;
+    for (const auto& [engine_name, engine] : engines) {
+        const auto build_start = Clock::now();
+        TransportRouter router(network.GetDatabase(), RouterSettings{}.SetBusWaitTime(6).SetBusVelocity(40).SetEngine(engine));
+        const std::chrono::duration<double> build_time = Clock::now() - build_start;
+
+        const auto query_start = Clock::now();
+        size_t found_count = 0;
+        for (const auto& [from, to] : queries) {
+            found_count += router.BuildRoute(from, to).has_value();
+        }
+        const std::chrono::duration<double> query_time = Clock::now() - query_start;
+
+        std::cout << engine_name << ": build "s << build_time.count() << " s, queries "s << query_time.count()
+                  << " s, total "s << (build_time + query_time).count() << " s ("s << found_count << " routes found)\n"s;
+    }
+    return 0;
+}
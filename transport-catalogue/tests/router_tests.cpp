@@ -0,0 +1,373 @@
+/*
+Behaviour tests of the transport router, built next to the catalogue sources:
+    g++ -std=c++17 -O2 -pthread -I.. router_tests.cpp $(ls ../*.cpp | grep -v main.cpp) -o router_tests
+Every test checks the answers of an engine against the ones of the all-pairs table
+(or of a router built from scratch) on small random networks; the JSON tests compare
+the whole output of hand-made requests.
+*/
+#include "random_network.h"
+#include "../fixed_point_router.h"
+#include "../json_reader.h"
+#include "../map_renderer.h"
+#include "../request_handler.h"
+#include "../router_snapshot.h"
+#include "../transport_catalogue.h"
+#include "../transport_router.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+using catalogue::domain::RouterEngine;
+using catalogue::domain::RouterSettings;
+using catalogue::router::TransportRouter;
+using tests::RandomNetwork;
+
+#define ASSERT_HINT(expr, hint)                                                              \
+    if (!(expr)) {                                                                           \
+        std::cerr << __FILE__ << "("s << __LINE__ << "): "s << #expr << " failed: "s << (hint) << '\n'; \
+        std::abort();                                                                        \
+    }
+
+#define RUN_TEST(func)                 \
+    func();                            \
+    std::cerr << #func << " OK"s << '\n'
+
+namespace {
+    RouterSettings MakeSettings(RouterEngine engine) {
+        return RouterSettings{}.SetBusWaitTime(6).SetBusVelocity(40).SetEngine(engine);
+    }
+
+    //the total times of every pair of stops agree, and so do the stops without a route;
+    //the tolerance is relative to the expected time (or to a minute for shorter routes)
+    void AssertSameTotalTimes(const TransportRouter& router, const TransportRouter& expected_router,
+                              const std::vector<std::string>& stopnames, const std::string& hint,
+                              double tolerance = 1e-6) {
+        for (const auto& from : stopnames) {
+            for (const auto& to : stopnames) {
+                const auto route = router.BuildRoute(from, to);
+                const auto expected_route = expected_router.BuildRoute(from, to);
+                ASSERT_HINT(route.has_value() == expected_route.has_value(), hint + ": "s + from + " -> "s + to);
+                if (route) {
+                    ASSERT_HINT(std::abs(route -> total_time - expected_route -> total_time)
+                                <= tolerance * std::max(1.0, expected_route -> total_time), hint + ": "s + from + " -> "s + to);
+                }
+            }
+        }
+    }
+
+    //the items of every route add up to its total time
+    void AssertConsistentItems(const TransportRouter& router, const std::vector<std::string>& stopnames,
+                               const std::string& hint) {
+        for (const auto& from : stopnames) {
+            for (const auto& to : stopnames) {
+                if (const auto route = router.BuildRoute(from, to)) {
+                    double items_time = 0;
+                    for (const auto item : route -> items) {
+                        items_time += item.weight;
+                    }
+                    ASSERT_HINT(std::abs(items_time - route -> total_time) <= 1e-6 * std::max(1.0, route -> total_time),
+                                hint + ": "s + from + " -> "s + to);
+                }
+            }
+        }
+    }
+
+    //a network of 24 stops, six buses and four stops without buses
+    RandomNetwork MakeNetwork(unsigned seed) {
+        RandomNetwork network(seed, 24);
+        for (size_t bus = 0; bus < 6; bus++) {
+            network.AddBus("Bus "s + std::to_string(bus), network.Random(2, 8), bus % 2 == 0, 0, 20);
+        }
+        return network;
+    }
+
+    std::string ReadFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void WriteFile(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+
+    //the whole output of the requests, as the program prints it
+    json::Document ProcessRequests(const std::string& input) {
+        std::istringstream input_stream(input);
+        auto requests = json::input::ParseInput(input_stream);
+        catalogue::database::TransportCatalogue database;
+        json::input::ApplyBaseRequests(database, requests.base_requests);
+        TransportRouter router(database, requests.router_settings);
+        svg::MapRenderer renderer(requests.render_settings);
+        catalogue::request_handler::RequestHandler handler(database, router, renderer);
+        std::ostringstream output;
+        json::output::PrintStats(handler, requests.stat_requests, output);
+        std::istringstream output_stream(output.str());
+        return json::Load(output_stream);
+    }
+} //namespace
+
+/*
+Every engine answers the total times of the all-pairs table, in both graph models. The
+float table rounds its sums and the fixed-point one may pick a route up to half a unit
+(1/600 of a minute) per edge longer, so they are compared with looser tolerances.
+*/
+void TestEnginesAgainstAllPairs() {
+    const std::vector<std::tuple<std::string, RouterEngine, double>> engines = {
+        {"compact"s, RouterEngine::COMPACT_ALL_PAIRS, 1e-6}, {"compact_float"s, RouterEngine::COMPACT_FLOAT_ALL_PAIRS, 1e-5},
+        {"fixed_point"s, RouterEngine::FIXED_POINT_ALL_PAIRS, 1e-2}, {"dijkstra"s, RouterEngine::DIJKSTRA, 1e-6},
+        {"cached_trees"s, RouterEngine::SHORTEST_PATH_TREES, 1e-6}, {"bidirectional_dijkstra"s, RouterEngine::BIDIRECTIONAL_DIJKSTRA, 1e-6},
+        {"a_star"s, RouterEngine::A_STAR, 1e-6}, {"landmarks"s, RouterEngine::LANDMARKS, 1e-6},
+        {"contraction_hierarchy"s, RouterEngine::CONTRACTION_HIERARCHY, 1e-6}, {"hub_labels"s, RouterEngine::HUB_LABELS, 1e-6},
+        {"route_patterns"s, RouterEngine::ROUTE_PATTERNS, 1e-6}, {"auto"s, RouterEngine::AUTO, 1e-6},
+    };
+    for (unsigned seed = 1; seed <= 4; seed++) {
+        auto network = MakeNetwork(seed);
+        const auto& database = network.GetDatabase();
+        const auto& stopnames = network.GetStopnames();
+        for (const bool single_vertex_per_stop : {false, true}) {
+            const auto settings = MakeSettings(RouterEngine::ALL_PAIRS).SetSingleVertexPerStop(single_vertex_per_stop);
+            const TransportRouter expected_router(database, settings);
+            for (const auto& [engine_name, engine, tolerance] : engines) {
+                const std::string hint = "seed "s + std::to_string(seed) + ", "s + engine_name
+                                       + (single_vertex_per_stop ? ", single vertex per stop"s : ""s);
+                const TransportRouter router(database, RouterSettings(settings).SetEngine(engine).SetLandmarkCount(3)
+                                                                               .SetRouteTreeCacheSize(2));
+                AssertSameTotalTimes(router, expected_router, stopnames, hint, tolerance);
+                AssertConsistentItems(router, stopnames, hint);
+            }
+        }
+    }
+}
+
+/*
+The three min-plus row kernels leave the same weights and predecessors on random rows,
+sentinels included, of lengths covering every vector tail. The kernels the processor
+lacks are skipped.
+*/
+void TestMinPlusKernels() {
+    namespace min_plus = graph::min_plus;
+    std::vector<std::pair<std::string, min_plus::RowKernel>> kernels;
+#ifdef GRAPH_MIN_PLUS_X86_KERNELS
+    if (__builtin_cpu_supports("sse4.1")) {
+        kernels.emplace_back("sse4.1"s, &min_plus::RelaxRowSse41);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.emplace_back("avx2"s, &min_plus::RelaxRowAvx2);
+    }
+#endif
+    std::mt19937 generator(7);
+    auto random_weight = [&generator]() {
+        //a quarter of the cells are unreachable
+        return std::uniform_int_distribution<int>(0, 3)(generator) == 0 ? min_plus::INFINITE_WEIGHT
+             : std::uniform_int_distribution<min_plus::FixedWeight>(0, 100000)(generator);
+    };
+    for (size_t count = 0; count <= 40; count++) {
+        for (size_t row = 0; row < 20; row++) {
+            const min_plus::FixedWeight weight_from = std::uniform_int_distribution<min_plus::FixedWeight>(0, 50000)(generator);
+            std::vector<min_plus::FixedWeight> row_through(count);
+            std::vector<min_plus::FixedWeight> row_from(count);
+            std::vector<min_plus::EdgeIndex> prev_row_through(count);
+            std::vector<min_plus::EdgeIndex> prev_row_from(count);
+            for (size_t index = 0; index < count; index++) {
+                row_through[index] = random_weight();
+                row_from[index] = random_weight();
+                prev_row_through[index] = static_cast<min_plus::EdgeIndex>(generator());
+                prev_row_from[index] = static_cast<min_plus::EdgeIndex>(generator());
+            }
+            auto expected_row = row_from;
+            auto expected_prev_row = prev_row_from;
+            min_plus::RelaxRowScalar(weight_from, row_through.data(), prev_row_through.data(),
+                                     expected_row.data(), expected_prev_row.data(), count);
+            for (const auto& [kernel_name, kernel] : kernels) {
+                auto kernel_row = row_from;
+                auto kernel_prev_row = prev_row_from;
+                kernel(weight_from, row_through.data(), prev_row_through.data(), kernel_row.data(), kernel_prev_row.data(), count);
+                const std::string hint = kernel_name + ", "s + std::to_string(count) + " cells"s;
+                ASSERT_HINT(kernel_row == expected_row, hint);
+                ASSERT_HINT(kernel_prev_row == expected_prev_row, hint);
+            }
+        }
+    }
+}
+
+/*
+A snapshot written by one start answers the next start the same way. A damaged graph
+section is refused, and the router rebuilds; a damaged table is not detected when it is
+opened, but the routes walked through it are never wrong or broken: they are either the
+right ones or not found.
+*/
+void TestRouterSnapshot() {
+    const auto path = std::filesystem::temp_directory_path() / ("router_tests_snapshot_"s + std::to_string(std::random_device{}()));
+    auto network = MakeNetwork(5);
+    const auto& database = network.GetDatabase();
+    const auto& stopnames = network.GetStopnames();
+    const TransportRouter expected_router(database, MakeSettings(RouterEngine::ALL_PAIRS));
+    const auto settings = MakeSettings(RouterEngine::COMPACT_ALL_PAIRS).SetSnapshotPath(path.string());
+    const auto fingerprint = catalogue::router::RouterSnapshot::ComputeFingerprint(database, settings);
+
+    //the first start writes the snapshot, the second one maps it
+    AssertSameTotalTimes(TransportRouter(database, settings), expected_router, stopnames, "snapshot written"s);
+    ASSERT_HINT(catalogue::router::RouterSnapshot::Open(path.string(), fingerprint, database) != nullptr, "snapshot written"s);
+    AssertSameTotalTimes(TransportRouter(database, settings), expected_router, stopnames, "snapshot mapped"s);
+    AssertConsistentItems(TransportRouter(database, settings), stopnames, "snapshot mapped"s);
+    const std::string contents = ReadFile(path);
+
+    //a byte of the stop names, right after the header
+    std::string damaged_graph = contents;
+    damaged_graph[128] ^= 0x20;
+    WriteFile(path, damaged_graph);
+    ASSERT_HINT(catalogue::router::RouterSnapshot::Open(path.string(), fingerprint, database) == nullptr, "damaged graph"s);
+    AssertSameTotalTimes(TransportRouter(database, settings), expected_router, stopnames, "damaged graph"s);
+
+    //predecessor edges at the end of the table, some of them edges of the graph
+    std::string damaged_table = contents;
+    std::mt19937 generator(11);
+    for (size_t offset = damaged_table.size() - 1024; offset < damaged_table.size(); offset += sizeof(std::uint32_t)) {
+        const std::uint32_t edge = std::uniform_int_distribution<std::uint32_t>(0, 100)(generator);
+        damaged_table.replace(offset, sizeof(edge), reinterpret_cast<const char*>(&edge), sizeof(edge));
+    }
+    WriteFile(path, damaged_table);
+    ASSERT_HINT(catalogue::router::RouterSnapshot::Open(path.string(), fingerprint, database) != nullptr, "damaged table"s);
+    const TransportRouter damaged_router(database, settings);
+    for (const auto& from : stopnames) {
+        for (const auto& to : stopnames) {
+            if (const auto route = damaged_router.BuildRoute(from, to)) {
+                const auto expected_route = expected_router.BuildRoute(from, to);
+                ASSERT_HINT(expected_route && std::abs(route -> total_time - expected_route -> total_time) <= 1e-6,
+                            "damaged table: "s + from + " -> "s + to);
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+/*
+The output of RouteMatrix and Isochrone requests on a line A - B - C of 2 and 3 minute rides
+(at 36 km/h) with 6 minutes of waiting, plus a stop D without buses. Every engine answers
+through its own matrix and isochrone code, so each one prints the same output.
+*/
+void TestMatrixAndIsochroneOutput() {
+    const std::string base_requests = R"([
+        {"type": "Stop", "name": "A", "latitude": 55.60, "longitude": 37.60, "road_distances": {"B": 1200}},
+        {"type": "Stop", "name": "B", "latitude": 55.61, "longitude": 37.60, "road_distances": {"C": 1800}},
+        {"type": "Stop", "name": "C", "latitude": 55.62, "longitude": 37.60, "road_distances": {}},
+        {"type": "Stop", "name": "D", "latitude": 55.63, "longitude": 37.60, "road_distances": {}},
+        {"type": "Bus", "name": "1", "stops": ["A", "B", "C"], "is_roundtrip": false}
+    ])";
+    const std::string stat_requests = R"([
+        {"id": 1, "type": "RouteMatrix", "from": ["A", "C", "D"], "to": ["A", "B", "C"]},
+        {"id": 2, "type": "Isochrone", "from": "A", "max_time": 10},
+        {"id": 3, "type": "Isochrone", "from": "B", "max_time": 9},
+        {"id": 4, "type": "Isochrone", "from": "D", "max_time": 10}
+    ])";
+    const std::string render_settings = R"({
+        "width": 600, "height": 400, "padding": 50, "line_width": 14, "stop_radius": 5,
+        "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+        "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+        "color_palette": ["green", [255, 160, 0], "red"]
+    })";
+    std::istringstream expected_output(R"([
+        {"request_id": 1, "total_time": [[0, 8, 11], [11, 9, 0], [null, null, null]]},
+        {"request_id": 2, "items": [{"stop_name": "A", "total_time": 0}, {"stop_name": "B", "total_time": 8}]},
+        {"request_id": 3, "items": [{"stop_name": "B", "total_time": 0}, {"stop_name": "A", "total_time": 8},
+                                    {"stop_name": "C", "total_time": 9}]},
+        {"request_id": 4, "error_message": "not found"}
+    ])");
+    const auto expected = json::Load(expected_output);
+
+    for (const std::string engine : {"all_pairs"s, "compact"s, "fixed_point"s, "dijkstra"s, "cached_trees"s,
+                                     "contraction_hierarchy"s, "hub_labels"s, "route_patterns"s}) {
+        const std::string input = R"({"base_requests": )"s + base_requests + R"(, "stat_requests": )"s + stat_requests
+                                + R"(, "render_settings": )"s + render_settings
+                                + R"(, "routing_settings": {"bus_wait_time": 6, "bus_velocity": 36, "router_engine": ")"s
+                                + engine + R"("}})"s;
+        ASSERT_HINT(ProcessRequests(input) == expected, engine);
+    }
+}
+
+/*
+The incremental updates against a router built from scratch over the changed database:
+new distances, a bus of the stops of another one, a bus joining two components and a
+bus serving a stop without buses so far.
+*/
+void TestIncrementalUpdates() {
+    const std::vector<std::pair<RouterEngine, bool>> engines = {
+        {RouterEngine::ALL_PAIRS, false}, {RouterEngine::ALL_PAIRS, true}, {RouterEngine::COMPACT_ALL_PAIRS, true},
+        {RouterEngine::DIJKSTRA, false}, {RouterEngine::ROUTE_PATTERNS, false},
+    };
+    for (unsigned seed = 1; seed <= 4; seed++) {
+        for (const auto& [engine, prune_dominated_edges] : engines) {
+            const std::string hint = "seed "s + std::to_string(seed) + ", engine "s + std::to_string(static_cast<int>(engine))
+                                   + (prune_dominated_edges ? ", pruned"s : ""s);
+            //the stops of the second half are left without buses at first
+            RandomNetwork network(seed, 24);
+            const auto& stopnames = network.GetStopnames();
+            network.AddBus("A"s, 6, false, 0, 6);
+            network.AddBus("B"s, 5, true, 0, 6);
+            network.AddBus("C"s, 6, false, 6, 12);
+            auto& database = network.GetDatabase();
+            const auto settings = MakeSettings(engine).SetPruneDominatedEdges(prune_dominated_edges);
+            TransportRouter router(database, settings);
+
+            //new distances of the segments ridden by the buses
+            for (size_t update = 0; update < 6; update++) {
+                const auto bus = database.FindRoute(update % 2 ? "A"sv : "C"sv);
+                const size_t index = network.Random(1, bus -> stops.size() - 1);
+                const std::string from = bus -> stops[index - 1] -> name;
+                const std::string to = bus -> stops[index] -> name;
+                network.SetRandomDistance(from, to);
+                router.UpdateDistance(from, to);
+                AssertSameTotalTimes(router, TransportRouter(database, settings), stopnames, hint + ", distance update"s);
+            }
+
+            //a bus of the same stops as A shares its edges
+            const auto bus_a = database.FindRoute("A"sv);
+            std::vector<std::string> stops_a;
+            for (const auto& stop : bus_a -> stops) {
+                stops_a.push_back(stop -> name);
+            }
+            database.AddRoute("AA"s, stops_a, false);
+            router.AddRoute("AA"sv);
+            AssertSameTotalTimes(router, TransportRouter(database, settings), stopnames, hint + ", same stops"s);
+
+            //joins the components of A and C
+            const std::string stop_a = bus_a -> stops.front() -> name;
+            const std::string stop_c = database.FindRoute("C"sv) -> stops.front() -> name;
+            database.SetDistance(stop_a, stop_c, 700);
+            database.AddRoute("D"s, {stop_a, stop_c}, false);
+            router.AddRoute("D"sv);
+            AssertSameTotalTimes(router, TransportRouter(database, settings), stopnames, hint + ", joined components"s);
+
+            //serves a stop without buses so far, which rebuilds the graph
+            database.SetDistance(stop_c, stopnames[20], 900);
+            database.AddRoute("E"s, {stop_c, stopnames[20], stop_c}, true);
+            router.AddRoute("E"sv);
+            AssertSameTotalTimes(router, TransportRouter(database, settings), stopnames, hint + ", new stop"s);
+
+            //rides of the graph rebuilt above are updated in place again
+            network.SetRandomDistance(stop_a, stop_c);
+            router.UpdateDistance(stop_a, stop_c);
+            AssertSameTotalTimes(router, TransportRouter(database, settings), stopnames, hint + ", after rebuild"s);
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(TestEnginesAgainstAllPairs);
+    RUN_TEST(TestMinPlusKernels);
+    RUN_TEST(TestRouterSnapshot);
+    RUN_TEST(TestMatrixAndIsochroneOutput);
+    RUN_TEST(TestIncrementalUpdates);
+    return 0;
+}
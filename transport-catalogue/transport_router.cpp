@@ -1,6 +1,11 @@
 #include "transport_router.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
 
 namespace catalogue {
     namespace router {
@@ -8,35 +13,624 @@ namespace catalogue {
         // TransportRouter public member functions definition
 
         TransportRouter::TransportRouter(const Database& source, const domain::RouterSettings& settings)
-        : graph_(TransportRouter::TransportGraphFactory{source, settings}.MakeTransportGraph())
-        , router_(graph_) 
+        : database_(source)
+        , settings_(settings)
+        , graph_(std::vector<Stop>{})
+        , query_threads_(parallel::ResolveWorkerCount(settings.query_threads))
         {
+            InstallGraph(BuildGraph(source, settings_));
+            //the engine of the "auto" setting is known only once the graph is built
+            if (settings_.engine == domain::RouterEngine::AUTO) {
+                settings_.engine = SelectEngine();
+                if (UsesSnapshot(settings_)) {
+                    if (auto build = OpenSnapshot(source, settings_)) {
+                        InstallGraph(std::move(*build));
+                    } else {
+                        snapshot_fingerprint_ = RouterSnapshot::ComputeFingerprint(source, settings_);
+                    }
+                }
+            }
+            if (!settings_.snapshot_path.empty() && !UsesSnapshot(settings_)) {
+                std::cerr << "router_snapshot is ignored, only the all_pairs and compact engines use it\n";
+            }
+            if (settings_.engine == domain::RouterEngine::ROUTE_PATTERNS) {
+                pattern_router_ = std::make_unique<RoutePatternRouter>(source, settings_);
+            } else if (snapshot_) {
+                router_ = std::make_unique<graph::CompactRouter<Time>>(graph_, snapshot_ -> GetWeights(), snapshot_ -> GetPrevEdges());
+            } else if (UsesSnapshot(settings_)) {
+                auto table = std::make_unique<graph::CompactRouter<Time>>(graph_, settings_.build_threads);
+                if (!RouterSnapshot::Write(settings_.snapshot_path, snapshot_fingerprint_, graph_, pruned_edge_count_, bus_edges_, *table)) {
+                    std::cerr << "unable to write the router snapshot to " << settings_.snapshot_path << '\n';
+                }
+                router_ = std::move(table);
+            } else {
+                router_ = MakeRouter(source, settings_);
+            }
         }
 
         std::optional<TransportRouter::RoutePlan> TransportRouter::BuildRoute(std::string_view from, std::string_view to) const {
+            if (pattern_router_) {
+                return pattern_router_ -> BuildRoute(from, to);
+            }
+
             auto from_index = graph_.GetVertexId(from);
             auto to_index = graph_.GetVertexId(to);
             
             if (from_index && to_index) {
-                auto result = router_.BuildRoute(*from_index, *to_index);
+                auto result = router_ -> BuildRoute(*from_index, *to_index);
                 if (result) {
-                    return ProcessRouteInfo(*result);
+                    return ProcessRouteInfo(std::move(*result));
                 }
             }
 
             return {};
         } 
 
+        TransportRouter::TimeMatrix TransportRouter::BuildTimeMatrix(const std::vector<std::string>& from, 
+                                                                     const std::vector<std::string>& to) const {
+            TimeMatrix matrix(from.size(), std::vector<std::optional<Time>>(to.size()));
+
+            if (pattern_router_) {
+                parallel::ForEachIndex(from.size(), query_threads_, [&](size_t row) {
+                    for (size_t column = 0; column < to.size(); column++) {
+                        if (auto route_plan = pattern_router_ -> BuildRoute(from[row], to[column])) {
+                            matrix[row][column] = route_plan -> total_time;
+                        }
+                    }
+                });
+                return matrix;
+            }
+
+            auto resolve = [this](const std::vector<std::string>& names) {
+                std::vector<const graph::VertexId*> vertexes;
+                vertexes.reserve(names.size());
+                for (const auto& name : names) {
+                    vertexes.push_back(graph_.GetVertexId(name));
+                }
+                return vertexes;
+            };
+            const auto from_vertexes = resolve(from);
+            const auto to_vertexes = resolve(to);
+
+            if (hub_label_router_) {
+                parallel::ForEachIndex(from.size(), query_threads_, [&](size_t row) {
+                    for (size_t column = 0; column < to.size(); column++) {
+                        if (from_vertexes[row] && to_vertexes[column]) {
+                            matrix[row][column] = hub_label_router_ -> GetWeight(*from_vertexes[row], *to_vertexes[column]);
+                        }
+                    }
+                });
+                return matrix;
+            }
+
+            //search from the smaller side, backwards when it is the destinations
+            const bool by_destination = to.size() < from.size();
+            const auto& sources = by_destination ? to_vertexes : from_vertexes;
+            const auto& targets = by_destination ? from_vertexes : to_vertexes;
+            parallel::ForEachIndex(sources.size(), query_threads_, [&](size_t source) {
+                if (!sources[source]) {
+                    return;
+                }
+                const auto weights = graph::ComputeShortestWeights(graph_, *sources[source], by_destination);
+                for (size_t target = 0; target < targets.size(); target++) {
+                    if (targets[target]) {
+                        (by_destination ? matrix[target][source] : matrix[source][target]) = weights[*targets[target]];
+                    }
+                }
+            });
+            return matrix;
+        }
+
+        std::optional<TransportRouter::Isochrone> TransportRouter::BuildIsochrone(std::string_view from, Time max_time) const {
+            std::optional<Isochrone> isochrone;
+            if (pattern_router_) {
+                isochrone = pattern_router_ -> BuildIsochrone(from, max_time);
+            } else if (auto from_index = graph_.GetVertexId(from)) {
+                isochrone.emplace();
+                for (const auto& [vertex, total_time] : graph::ComputeWeightsWithin(graph_, *from_index, max_time)) {
+                    //a stop is reached at its portal vertex, the hub is reached after the wait
+                    if (graph_.SingleToDoubleVertexPos(graph_.DoubleToSingleVertexPos(vertex)) != vertex) {
+                        continue;
+                    }
+                    if (const auto stop = graph_.GetVertex(vertex); stop && *stop) {
+                        isochrone -> push_back({(*stop) -> name, total_time});
+                    }
+                }
+            }
+            if (isochrone) {
+                //equal times are ordered by the stop names
+                std::sort(isochrone -> begin(), isochrone -> end(), [](const ReachableStop& lhs, const ReachableStop& rhs) {
+                    return std::tie(lhs.total_time, lhs.stop_name) < std::tie(rhs.total_time, rhs.stop_name);
+                });
+            }
+            return isochrone;
+        }
+
+        size_t TransportRouter::GetPrunedEdgeCount() const {
+            return pruned_edge_count_;
+        }
+
+        graph::ShortestPathTreeCache<TransportRouter::Time>::Stats TransportRouter::GetRouteCacheStats() const {
+            return tree_cache_ ? tree_cache_ -> GetStats() : graph::ShortestPathTreeCache<Time>::Stats{};
+        }
+
+        void TransportRouter::UpdateDistance(std::string_view from, std::string_view to) {
+            if (pattern_router_) {
+                pattern_router_ = std::make_unique<RoutePatternRouter>(database_, settings_);
+                return;
+            }
+            TransportGraphFactory factory{database_, settings_};
+            UpdateRouter(factory.UpdateSegmentEdges(graph_, bus_edges_, from, to));
+        }
+
+        void TransportRouter::AddRoute(std::string_view busname) {
+            if (pattern_router_) {
+                pattern_router_ = std::make_unique<RoutePatternRouter>(database_, settings_);
+                return;
+            }
+            const auto bus = database_.FindRoute(busname);
+            if (!bus || bus -> stops.empty()) {
+                return;
+            }
+            //a stop served for the first time has no vertexes yet
+            if (std::any_of(bus -> stops.begin(), bus -> stops.end(), [this](const Stop& stop) { return !graph_.GetVertexId(stop -> name); })) {
+                InstallGraph(BuildGraph(database_, settings_));
+                router_ = MakeRouter(database_, settings_);
+                return;
+            }
+            TransportGraphFactory factory{database_, settings_};
+            const auto changed_edges = factory.AddBusEdges(graph_, bus_edges_, bus);
+            graph_.Freeze();
+            pruned_edge_count_ += factory.GetPrunedEdgeCount();
+            UpdateRouter(changed_edges);
+        }
+
         //private class member functions
-        TransportRouter::RoutePlan TransportRouter::ProcessRouteInfo(const Router::RouteInfo& route_info) const {
-            std::vector<Graph::EdgeSegmentInfo> edges;
-            for (auto edge_id : route_info.edges) {
-                auto data = graph_.GetEdgeSegmentInfo(edge_id);
-                edges.push_back(data);
-                //std::cerr << data.path_name << " - " << data.edge -> from << " -> " << data.edge -> to << " = " << data.edge -> weight << std::endl;
-            }
-            return {route_info.weight, std::move(edges)};
+        TransportRouter::GraphBuild TransportRouter::BuildGraph(const Database& source, const domain::RouterSettings& settings) const {
+            //the route pattern engine does not need the graph at all
+            if (settings.engine == domain::RouterEngine::ROUTE_PATTERNS) {
+                return {Graph(std::vector<Stop>{})};
+            }
+            std::optional<GraphBuild> build;
+            if (UsesSnapshot(settings)) {
+                build = OpenSnapshot(source, settings);
+            }
+            if (!build) {
+                TransportGraphFactory factory{source, settings};
+                build = GraphBuild{factory.MakeTransportGraph()};
+                build -> pruned_edge_count = factory.GetPrunedEdgeCount();
+                build -> bus_edges = factory.ReleaseBusEdges();
+                build -> graph.Freeze();
+                //the fingerprint the snapshot is written with
+                if (UsesSnapshot(settings)) {
+                    build -> snapshot_fingerprint = RouterSnapshot::ComputeFingerprint(source, settings);
+                }
+            }
+            if (settings.prune_dominated_edges) {
+                std::cerr << "transport graph: " << build -> graph.GetVertexCount() << " vertexes, " << build -> graph.GetEdgeCount() 
+                          << " edges, " << build -> pruned_edge_count << " dominated edges pruned\n";
+            }
+            return std::move(*build);
+        }
+
+        std::optional<TransportRouter::GraphBuild> TransportRouter::OpenSnapshot(const Database& source, 
+                                                                                const domain::RouterSettings& settings) const {
+            const std::uint64_t fingerprint = RouterSnapshot::ComputeFingerprint(source, settings);
+            auto snapshot = RouterSnapshot::Open(settings.snapshot_path, fingerprint, source);
+            if (!snapshot) {
+                return std::nullopt;
+            }
+            GraphBuild build{snapshot -> MakeGraph(), snapshot -> MakeBusEdges(), snapshot -> GetPrunedEdgeCount(), fingerprint};
+            build.graph.Freeze();
+            build.snapshot = std::move(snapshot);
+            return build;
+        }
+
+        void TransportRouter::InstallGraph(GraphBuild build) {
+            router_.reset();
+            tree_cache_ = nullptr;
+            all_pairs_router_ = nullptr;
+            hub_label_router_ = nullptr;
+            graph_ = std::move(build.graph);
+            bus_edges_ = std::move(build.bus_edges);
+            pruned_edge_count_ = build.pruned_edge_count;
+            snapshot_fingerprint_ = build.snapshot_fingerprint;
+            snapshot_ = std::move(build.snapshot);
+        }
+
+        std::unique_ptr<TransportRouter::RouteBuilder> TransportRouter::MakeRouter(const Database& source, const domain::RouterSettings& settings) {
+            const Graph& graph = graph_;
+            switch (settings.engine) {
+                case domain::RouterEngine::SHORTEST_PATH_TREES: {
+                    auto tree_cache = std::make_unique<graph::ShortestPathTreeCache<Time>>(graph, settings.route_tree_cache_size);
+                    tree_cache_ = tree_cache.get();
+                    return tree_cache;
+                }
+                case domain::RouterEngine::DIJKSTRA:
+                    return std::make_unique<graph::DijkstraRouter<Time>>(graph);
+                case domain::RouterEngine::BIDIRECTIONAL_DIJKSTRA:
+                    return std::make_unique<graph::BidirectionalDijkstraRouter<Time>>(graph);
+                case domain::RouterEngine::A_STAR:
+                    return std::make_unique<graph::DijkstraRouter<Time>>(graph, MakeGeoHeuristic(source, settings));
+                case domain::RouterEngine::LANDMARKS:
+                    return MakeLandmarkRouter(settings);
+                case domain::RouterEngine::CONTRACTION_HIERARCHY:
+                    return std::make_unique<graph::ContractionHierarchyRouter<Time>>(graph);
+                case domain::RouterEngine::HUB_LABELS:
+                    return MakeHubLabelRouter();
+                case domain::RouterEngine::COMPACT_ALL_PAIRS:
+                    return std::make_unique<graph::CompactRouter<Time>>(graph, settings.build_threads);
+                case domain::RouterEngine::COMPACT_FLOAT_ALL_PAIRS:
+                    return std::make_unique<graph::CompactRouter<Time, float>>(graph, settings.build_threads);
+                case domain::RouterEngine::FIXED_POINT_ALL_PAIRS:
+                    if (graph::FixedPointRouter<Time>::CanRepresent(graph, FIXED_POINT_UNITS_PER_MINUTE)) {
+                        return std::make_unique<graph::FixedPointRouter<Time>>(graph, FIXED_POINT_UNITS_PER_MINUTE, settings.build_threads);
+                    }
+                    //routes too long for the integer weights are left to the double table
+                    return std::make_unique<graph::CompactRouter<Time>>(graph, settings.build_threads);
+                case domain::RouterEngine::ALL_PAIRS:
+                case domain::RouterEngine::ROUTE_PATTERNS:
+                case domain::RouterEngine::AUTO:
+                    break;
+            }
+            auto all_pairs_router = std::make_unique<graph::Router<Time>>(graph, settings.build_threads);
+            all_pairs_router_ = all_pairs_router.get();
+            return all_pairs_router;
+        }
+
+        /*
+        Both candidates are estimated from the vertex and edge counts: the table costs V^2 cells
+        and V^3 relaxations to build, the search only its labels and queue per running query.
+        The graph itself is needed by both, so the budget is what the engine takes on top of it.
+        */
+        domain::RouterEngine TransportRouter::SelectEngine() const {
+            static const double BYTES_PER_MEGABYTE = 1024 * 1024;
+            static const double NANOSECONDS_PER_SECOND = 1e9;
+
+            const size_t vertex_count = graph_.GetVertexCount();
+            const size_t edge_count = graph_.GetEdgeCount();
+            const bool is_fixed_point = graph::FixedPointRouter<Time>::CanRepresent(graph_, FIXED_POINT_UNITS_PER_MINUTE);
+            const size_t table_memory = is_fixed_point ? graph::FixedPointRouter<Time>::EstimateMemoryUsage(vertex_count)
+                                                       : graph::CompactRouter<Time>::EstimateMemoryUsage(vertex_count);
+            const double relaxations = static_cast<double>(vertex_count) * vertex_count * vertex_count;
+            const double table_build_time = relaxations 
+                                          * (is_fixed_point ? FIXED_POINT_NANOSECONDS_PER_RELAXATION : COMPACT_NANOSECONDS_PER_RELAXATION)
+                                          / parallel::ResolveWorkerCount(settings_.build_threads) / NANOSECONDS_PER_SECOND;
+            const size_t search_memory = graph::DijkstraRouter<Time>::EstimateQueryMemoryUsage(vertex_count, edge_count) 
+                                       * query_threads_;
+            const bool uses_table = settings_.memory_budget == 0 || table_memory <= settings_.memory_budget;
+
+            std::cerr << "router engine: " << (uses_table ? (is_fixed_point ? "fixed_point" : "compact") : "dijkstra")
+                      << " for " << vertex_count << " vertexes and " << edge_count << " edges, table "
+                      << table_memory / BYTES_PER_MEGABYTE << " MB (projected build " << table_build_time << " s), search "
+                      << search_memory / BYTES_PER_MEGABYTE << " MB (no build), budget ";
+            if (settings_.memory_budget == 0) {
+                std::cerr << "unlimited\n";
+            } else {
+                std::cerr << settings_.memory_budget / BYTES_PER_MEGABYTE << " MB\n";
+            }
+
+            if (!uses_table) {
+                return domain::RouterEngine::DIJKSTRA;
+            }
+            return is_fixed_point ? domain::RouterEngine::FIXED_POINT_ALL_PAIRS : domain::RouterEngine::COMPACT_ALL_PAIRS;
+        }
+
+        /*
+        The ride time between two stops is at least their great-circle distance times the
+        smallest road/geo ratio over all bus segments, divided by the bus velocity. The road
+        distances are arbitrary input, so the ratio (usually about 1) keeps the bound admissible.
+        */
+        graph::DijkstraRouter<TransportRouter::Time>::Heuristic TransportRouter::MakeGeoHeuristic(const Database& source, 
+                                                                                                 const domain::RouterSettings& settings) const {
+            std::optional<double> min_road_to_geo_ratio;
+            for (const auto& bus : source.GetActiveRoutes()) {
+                const auto& stops = bus -> stops;
+                for (size_t index = 1; index < stops.size(); index++) {
+                    const double geo_distance = geo::ComputeDistance(stops[index - 1] -> coordinates, stops[index] -> coordinates);
+                    if (geo_distance <= 0) {
+                        continue;
+                    }
+                    //non-roundtrip buses ride the segments backwards as well
+                    double road_distance = source.GetDistance(stops[index - 1] -> name, stops[index] -> name);
+                    if (!(bus -> is_roundtrip)) {
+                        road_distance = std::min<double>(road_distance, source.GetDistance(stops[index] -> name, stops[index - 1] -> name));
+                    }
+                    min_road_to_geo_ratio = std::min(min_road_to_geo_ratio.value_or(road_distance / geo_distance), 
+                                                     road_distance / geo_distance);
+                }
+            }
+            if (!min_road_to_geo_ratio) {
+                return nullptr;
+            }
+
+            //a hair below the exact bound, so the rounding of ComputeDistance cannot overestimate
+            static const double ROUNDING_SLACK = 1 - 1e-9;
+            const Time minutes_per_geo_meter = *min_road_to_geo_ratio * ROUNDING_SLACK / 
+                                               (settings.bus_velocity * METERS_PER_KILOMETER / MINUTES_PER_HOUR);
+
+            std::vector<geo::Coordinates> coordinates(graph_.GetVertexCount());
+            for (graph::VertexId vertex = 0; vertex < coordinates.size(); vertex++) {
+                coordinates[vertex] = (*graph_.GetVertex(vertex)) -> coordinates;
+            }
+            return [coordinates = std::move(coordinates), minutes_per_geo_meter](graph::VertexId vertex, graph::VertexId target) {
+                return coordinates[vertex] == coordinates[target] ? Time{0}
+                     : geo::ComputeDistance(coordinates[vertex], coordinates[target]) * minutes_per_geo_meter;
+            };
+        }
+
+        std::unique_ptr<TransportRouter::RouteBuilder> TransportRouter::MakeLandmarkRouter(const domain::RouterSettings& settings) const {
+            //landmarks are stops, so only portal vertexes are candidates
+            std::vector<graph::VertexId> candidates;
+            for (graph::VertexId vertex = 0; vertex < graph_.GetVertexCount(); vertex++) {
+                if (graph_.SingleToDoubleVertexPos(graph_.DoubleToSingleVertexPos(vertex)) == vertex) {
+                    candidates.push_back(vertex);
+                }
+            }
+            auto landmarks = std::make_shared<const graph::Landmarks<Time>>(graph_, settings.landmark_count, 
+                                                                            candidates, settings.build_threads);
+            auto router = std::make_unique<graph::DijkstraRouter<Time>>(graph_, [landmarks](graph::VertexId vertex, graph::VertexId target) {
+                return landmarks -> GetLowerBound(vertex, target);
+            });
+            if (settings.report_landmark_stats) {
+                ReportLandmarkStats(*landmarks, *router);
+            }
+            return router;
+        }
+
+        std::unique_ptr<TransportRouter::RouteBuilder> TransportRouter::MakeHubLabelRouter() {
+            static const double BYTES_PER_MEGABYTE = 1024 * 1024;
+
+            const auto start = std::chrono::steady_clock::now();
+            auto router = std::make_unique<graph::HubLabelRouter<Time>>(graph_);
+            const std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - start;
+            hub_label_router_ = router.get();
+
+            const auto stats = router -> GetStats();
+            const double vertex_count = std::max<size_t>(stats.vertex_count, 1);
+            std::cerr << "hub labels for " << stats.vertex_count << " vertexes built in " << build_time.count() << " s"
+                      << ", out-labels: " << stats.out_label_entries / vertex_count << " average, " << stats.max_out_label_size << " max"
+                      << ", in-labels: " << stats.in_label_entries / vertex_count << " average, " << stats.max_in_label_size << " max"
+                      << ", " << stats.memory_usage / BYTES_PER_MEGABYTE << " MB\n";
+            return router;
+        }
+
+        //compares the landmark router with the plain search on a fixed sample of stop pairs
+        void TransportRouter::ReportLandmarkStats(const graph::Landmarks<Time>& landmarks, const RouteBuilder& landmark_router) const {
+            using Clock = std::chrono::steady_clock;
+            static const size_t SAMPLE_QUERIES = 100;
+
+            const graph::DijkstraRouter<Time> plain_router(graph_);
+            std::mt19937 generator(SAMPLE_QUERIES);
+            std::uniform_int_distribution<graph::VertexId> vertexes(0, graph_.GetVertexCount() - 1);
+            std::vector<std::pair<graph::VertexId, graph::VertexId>> queries;
+            for (size_t query = 0; query < SAMPLE_QUERIES && graph_.GetVertexCount() > 0; query++) {
+                queries.emplace_back(vertexes(generator), vertexes(generator));
+            }
+
+            auto measure = [&queries](const RouteBuilder& router) {
+                const auto start = Clock::now();
+                for (const auto& [from, to] : queries) {
+                    router.BuildRoute(from, to);
+                }
+                return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            };
+            const double plain_time = measure(plain_router);
+            const double landmark_time = measure(landmark_router);
+
+            std::cerr << "landmarks: " << landmarks.GetLandmarks().size()
+                      << ", preprocessing memory: " << landmarks.GetMemoryUsage() << " bytes"
+                      << ", " << queries.size() << " sample queries: " << plain_time << " ms plain, "
+                      << landmark_time << " ms with landmarks (" << plain_time - landmark_time << " ms saved)\n";
+        }
+
+        TransportRouter::RoutePlan TransportRouter::ProcessRouteInfo(RouteInfo route_info) const {
+            return {route_info.weight, RouteItems(graph_, std::move(route_info.edges))};
         }    
+
+        void TransportRouter::UpdateRouter(const std::vector<graph::EdgeId>& changed_edges) {
+            if (changed_edges.empty()) {
+                return;
+            }
+            if (all_pairs_router_) {
+                all_pairs_router_ -> UpdateEdges(changed_edges, settings_.build_threads);
+            } else {
+                //the precomputations of the other engines (bounds, shortcuts, compact tables, cached trees) are rebuilt
+                router_ = MakeRouter(database_, settings_);
+                //the snapshot table is stale now, the rebuilt router no longer needs the mapping
+                snapshot_.reset();
+            }
+        }
+
+        bool TransportRouter::UsesSnapshot(const domain::RouterSettings& settings) {
+            return !settings.snapshot_path.empty() && (settings.engine == domain::RouterEngine::ALL_PAIRS 
+                                                       || settings.engine == domain::RouterEngine::COMPACT_ALL_PAIRS);
+        }
+
+        // TransportRouter::RouteItems member functions definition
+
+        TransportRouter::RouteItems::RouteItems(const Graph& graph, std::vector<graph::EdgeId> edges)
+        : graph_(&graph)
+        , edges_(std::move(edges)) {
+        }
+
+        TransportRouter::RouteItems::RouteItems(std::vector<Item> items)
+        : items_(std::move(items)) {
+        }
+
+        TransportRouter::RouteItems::Iterator TransportRouter::RouteItems::begin() const {
+            if (graph_) {
+                return Iterator(graph_ -> GetRouteSegments(edges_).begin());
+            }
+            return Iterator(items_.data());
+        }
+
+        TransportRouter::RouteItems::Iterator TransportRouter::RouteItems::end() const {
+            if (graph_) {
+                return Iterator(graph_ -> GetRouteSegments(edges_).end());
+            }
+            return Iterator(items_.data() + items_.size());
+        }
+
+        // TransportRouter::RoutePatternRouter member functions definition
+
+        TransportRouter::RoutePatternRouter::RoutePatternRouter(const Database& source, const domain::RouterSettings& settings)
+        : stops_(source.GetActiveStops())
+        , stop_to_patterns_(stops_.size())
+        , bus_wait_time_(settings.bus_wait_time)
+        {
+            for (size_t index = 0; index < stops_.size(); index++) {
+                assert(stops_[index]);
+                stopname_to_index_[stops_[index] -> name] = index;
+            }
+
+            const Time minutes_per_meter = 1 / (settings.bus_velocity * METERS_PER_KILOMETER / MINUTES_PER_HOUR);
+            for (const auto& bus : source.GetActiveRoutes()) {
+                if (bus) {
+                    const auto& stops = bus -> stops;
+                    AddPattern(bus -> name, stops.begin(), stops.end(), source, minutes_per_meter);
+                    if (!(bus -> is_roundtrip)) {
+                        AddPattern(bus -> name, stops.rbegin(), stops.rend(), source, minutes_per_meter);
+                    }
+                }
+            }
+        }
+
+        template <typename Iter>
+        void TransportRouter::RoutePatternRouter::AddPattern(std::string_view busname, Iter first, Iter last, 
+                                                             const Database& source, Time minutes_per_meter) {
+            Pattern pattern{busname, {}, {}};
+            for (auto iter = first; iter != last; iter++) {
+                assert(*iter);
+                const size_t stop = stopname_to_index_.at((*iter) -> name);
+                pattern.ride_times.push_back(iter == first ? Time{0} : pattern.ride_times.back() + 
+                                             source.GetDistance((*std::prev(iter)) -> name, (*iter) -> name) * minutes_per_meter);
+                stop_to_patterns_[stop].push_back({patterns_.size(), pattern.stops.size()});
+                pattern.stops.push_back(stop);
+            }
+            patterns_.push_back(std::move(pattern));
+        }
+
+        std::optional<TransportRouter::RoutePlan> TransportRouter::RoutePatternRouter::BuildRoute(std::string_view from, std::string_view to) const {
+            auto from_iter = stopname_to_index_.find(from);
+            auto to_iter = stopname_to_index_.find(to);
+            if (from_iter == stopname_to_index_.end() || to_iter == stopname_to_index_.end()) {
+                return {};
+            }
+            const size_t source = from_iter -> second;
+            const size_t target = to_iter -> second;
+            if (source == target) {
+                return RoutePlan{0, RouteItems(std::vector<RouteItems::Item>{})};
+            }
+
+            const Rounds rounds = RunRounds(source, target, std::numeric_limits<Time>::infinity());
+            const auto& best_arrivals = rounds.best_arrivals;
+            const auto& round_labels = rounds.labels;
+            if (!best_arrivals[target]) {
+                return {};
+            }
+
+            //walk the labels back from the target, each ride boards where an earlier round arrived
+            std::vector<RouteItems::Item> items;
+            size_t round = round_labels.size() - 1;
+            size_t stop = target;
+            while (stop != source) {
+                while (!round_labels[round][stop]) {
+                    assert(round > 0);
+                    round--;
+                }
+                const Label& label = *round_labels[round][stop];
+                const Pattern& pattern = patterns_[label.pattern];
+                const size_t board_stop = pattern.stops[label.board_position];
+
+                items.push_back(RouteItems::Item{}.SetName(pattern.busname)
+                                                  .SetSpanCount(static_cast<int>(label.alight_position - label.board_position))
+                                                  .SetWeight(pattern.ride_times[label.alight_position] - pattern.ride_times[label.board_position]));
+                items.push_back(RouteItems::Item{}.SetName(stops_[board_stop] -> name)
+                                                  .SetSpanCount(0)
+                                                  .SetWeight(bus_wait_time_));
+                stop = board_stop;
+                round--;
+            }
+            std::reverse(items.begin(), items.end());
+
+            return RoutePlan{*best_arrivals[target], RouteItems(std::move(items))};
+        }
+
+        std::optional<TransportRouter::Isochrone> TransportRouter::RoutePatternRouter::BuildIsochrone(std::string_view from, Time max_time) const {
+            auto from_iter = stopname_to_index_.find(from);
+            if (from_iter == stopname_to_index_.end()) {
+                return {};
+            }
+            const Rounds rounds = RunRounds(from_iter -> second, std::nullopt, max_time);
+            Isochrone isochrone;
+            for (size_t stop = 0; stop < stops_.size(); stop++) {
+                if (const auto& arrival = rounds.best_arrivals[stop]) {
+                    isochrone.push_back({stops_[stop] -> name, *arrival});
+                }
+            }
+            return isochrone;
+        }
+
+        TransportRouter::RoutePatternRouter::Rounds 
+        TransportRouter::RoutePatternRouter::RunRounds(size_t source, std::optional<size_t> target, Time max_time) const {
+            static const size_t NO_POSITION = std::numeric_limits<size_t>::max();
+
+            //best arrival over all rounds so far, and the arrivals the current round boards from
+            std::vector<std::optional<Time>> best_arrivals(stops_.size());
+            best_arrivals[source] = 0;
+            std::vector<std::vector<std::optional<Label>>> round_labels(1, std::vector<std::optional<Label>>(stops_.size()));
+            std::vector<size_t> marked_stops{source};
+            std::vector<size_t> first_marked_position(patterns_.size(), NO_POSITION);
+
+            while (!marked_stops.empty()) {
+                const auto boarding_arrivals = best_arrivals;
+                //collect the patterns serving a stop improved in the previous round
+                std::vector<size_t> scanned_patterns;
+                for (size_t stop : marked_stops) {
+                    for (const auto& [pattern, position] : stop_to_patterns_[stop]) {
+                        if (first_marked_position[pattern] == NO_POSITION) {
+                            scanned_patterns.push_back(pattern);
+                        }
+                        first_marked_position[pattern] = std::min(first_marked_position[pattern], position);
+                    }
+                }
+
+                auto& labels = round_labels.emplace_back(stops_.size());
+                std::vector<size_t> improved_stops;
+                for (size_t pattern_index : scanned_patterns) {
+                    const Pattern& pattern = patterns_[pattern_index];
+                    //arrival + wait - ride time from the pattern's first stop, for the best boarding so far
+                    std::optional<Time> boarding;
+                    size_t board_position = 0;
+
+                    for (size_t position = std::exchange(first_marked_position[pattern_index], NO_POSITION);
+                         position < pattern.stops.size(); position++) {
+                        const size_t stop = pattern.stops[position];
+                        if (boarding) {
+                            const Time arrival = *boarding + pattern.ride_times[position];
+                            if ((!best_arrivals[stop] || arrival < *best_arrivals[stop]) && !(max_time < arrival) &&
+                                (!target || !best_arrivals[*target] || arrival < *best_arrivals[*target])) {
+                                if (!labels[stop]) {
+                                    improved_stops.push_back(stop);
+                                }
+                                best_arrivals[stop] = arrival;
+                                labels[stop] = Label{pattern_index, board_position, position};
+                            }
+                        }
+                        if (const auto& arrival = boarding_arrivals[stop]) {
+                            if (const Time candidate = *arrival + bus_wait_time_ - pattern.ride_times[position]; 
+                                !boarding || candidate < *boarding) {
+                                boarding = candidate;
+                                board_position = position;
+                            }
+                        }
+                    }
+                }
+                marked_stops = std::move(improved_stops);
+            }
+            return {std::move(best_arrivals), std::move(round_labels)};
+        }
     } // namespace router
 } //namespace catalogue
 
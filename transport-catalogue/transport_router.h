@@ -2,14 +2,32 @@
 
 #include "graph.h"
 #include "router.h"
+#include "dijkstra_router.h"
+#include "bidirectional_dijkstra_router.h"
+#include "compact_router.h"
+#include "fixed_point_router.h"
+#include "contraction_hierarchy_router.h"
+#include "hub_label_router.h"
+#include "landmarks.h"
+#include "shortest_path_tree_cache.h"
+#include "router_snapshot.h"
 #include "domain.h"
 #include "transport_catalogue.h"
+#include "parallel.h"
 
 #include <vector>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 #include <cassert>
 #include <stdexcept>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <tuple>
 
 namespace catalogue {
     namespace router {
@@ -21,19 +39,192 @@ namespace catalogue {
             using Time = double;
             using Stop = domain::StopPtr;
             using Graph = graph::DoubleVertexGraph<Time, Stop>;
-            using Router = graph::Router<Time>;
+            using RouteBuilder = graph::RouteBuilder<Time>;
+            using RouteInfo = graph::RouteInfo<Time>;
 
         public:
+            /*
+            Wait and ride items of a route. The graph engines keep only the edge ids and the items
+            are read from the graph as they are iterated, the route pattern engine stores its items.
+            Either way the names refer to the catalogue, so nothing is copied before the output is
+            written; the items stay valid until the router is updated.
+            */
+            class RouteItems {
+            public:
+                using Item = Graph::EdgeSegmentInfo;
+
+                class Iterator {
+                public:
+                    using iterator_category = std::input_iterator_tag;
+                    using value_type = Item;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = void;
+                    using reference = Item;
+
+                    explicit Iterator(Graph::SegmentIterator segment)
+                        : segment_(segment)
+                        , is_from_graph_(true) {
+                    }
+                    explicit Iterator(const Item* item)
+                        : item_(item) {
+                    }
+                    Item operator*() const {
+                        return is_from_graph_ ? *segment_ : *item_;
+                    }
+                    Iterator& operator++() {
+                        if (is_from_graph_) {
+                            ++segment_;
+                        } else {
+                            ++item_;
+                        }
+                        return *this;
+                    }
+                    bool operator==(const Iterator& other) const {
+                        return segment_ == other.segment_ && item_ == other.item_;
+                    }
+                    bool operator!=(const Iterator& other) const {
+                        return !(*this == other);
+                    }
+
+                private:
+                    Graph::SegmentIterator segment_;
+                    const Item* item_ = nullptr;
+                    bool is_from_graph_ = false;
+                };
+
+                RouteItems(const Graph& graph, std::vector<graph::EdgeId> edges);
+                explicit RouteItems(std::vector<Item> items);
+                Iterator begin() const;
+                Iterator end() const;
+
+            private:
+                const Graph* graph_ = nullptr;
+                std::vector<graph::EdgeId> edges_;
+                std::vector<Item> items_;
+            };
+
             struct RoutePlan {
                 Time total_time;
-                std::vector<Graph::EdgeSegmentInfo> items;
+                RouteItems items;
+            };
+
+            //[from][to] total times, nullopt where there is no route
+            using TimeMatrix = std::vector<std::vector<std::optional<Time>>>;
+
+            struct ReachableStop {
+                std::string_view stop_name;
+                Time total_time;
             };
+            //stops by their total times from the origin, the origin itself first
+            using Isochrone = std::vector<ReachableStop>;
 
             TransportRouter(const Database& source, const domain::RouterSettings& settings);
             std::optional<RoutePlan> BuildRoute(std::string_view from, std::string_view to) const;
+            //one search per stop of the smaller side (label merges with the hub-label engine), no route items are built
+            TimeMatrix BuildTimeMatrix(const std::vector<std::string>& from, const std::vector<std::string>& to) const;
+            //stops reachable from the origin within max_time, one search bounded by max_time; nullopt for an unknown origin
+            std::optional<Isochrone> BuildIsochrone(std::string_view from, Time max_time) const;
+            //parallel edges dropped while building the graph
+            size_t GetPrunedEdgeCount() const;
+            //hits and misses of the shortest path tree cache (zeros for the other engines)
+            graph::ShortestPathTreeCache<Time>::Stats GetRouteCacheStats() const;
+
+            /*
+            Incremental maintenance, to be called after the database was changed: only the
+            rides affected are recomputed and the all-pairs engine repairs its table in place,
+            the other engines are rebuilt over the updated graph.
+            */
+            //after database.SetDistance(from, to, ...)
+            void UpdateDistance(std::string_view from, std::string_view to);
+            //after database.AddRoute(busname, ...); a bus serving a stop without buses so far rebuilds the graph
+            void AddRoute(std::string_view busname);
 
         private:
-            RoutePlan ProcessRouteInfo(const Router::RouteInfo& route_info) const;
+            static constexpr int METERS_PER_KILOMETER = 1000;
+            static constexpr int MINUTES_PER_HOUR = 60;
+            //the fixed-point table counts in deci-seconds
+            static constexpr double FIXED_POINT_UNITS_PER_MINUTE = 600;
+            //build cost of one Floyd-Warshall relaxation on a single worker, measured on x86-64
+            static constexpr double FIXED_POINT_NANOSECONDS_PER_RELAXATION = 0.2;
+            static constexpr double COMPACT_NANOSECONDS_PER_RELAXATION = 1.0;
+
+            //ride edges of every bus in the order they are generated (with pruning, the surviving edge of the pair)
+            using BusEdges = std::unordered_map<std::string_view, std::vector<graph::EdgeId>>;
+
+            //a graph with the data derived along with it, built aside until it replaces the current one
+            struct GraphBuild {
+                Graph graph;
+                BusEdges bus_edges;
+                size_t pruned_edge_count = 0;
+                std::uint64_t snapshot_fingerprint = 0;
+                std::unique_ptr<RouterSnapshot> snapshot;
+            };
+
+            GraphBuild BuildGraph(const Database& source, const domain::RouterSettings& settings) const;
+            //the graph stored in the snapshot, nullopt when there is no usable snapshot for the data
+            std::optional<GraphBuild> OpenSnapshot(const Database& source, const domain::RouterSettings& settings) const;
+            //drops the router first, since it refers to the graph and may answer from the old snapshot mapping
+            void InstallGraph(GraphBuild build);
+            std::unique_ptr<RouteBuilder> MakeRouter(const Database& source, const domain::RouterSettings& settings);
+            //the engine of the "auto" setting for the graph built, the decision is logged
+            domain::RouterEngine SelectEngine() const;
+            graph::DijkstraRouter<Time>::Heuristic MakeGeoHeuristic(const Database& source, const domain::RouterSettings& settings) const;
+            std::unique_ptr<RouteBuilder> MakeLandmarkRouter(const domain::RouterSettings& settings) const;
+            void ReportLandmarkStats(const graph::Landmarks<Time>& landmarks, const RouteBuilder& landmark_router) const;
+            std::unique_ptr<RouteBuilder> MakeHubLabelRouter();
+            RoutePlan ProcessRouteInfo(RouteInfo route_info) const;
+            void UpdateRouter(const std::vector<graph::EdgeId>& changed_edges);
+            //the snapshot stores the compact all-pairs table, so only the all-pairs engines use it
+            static bool UsesSnapshot(const domain::RouterSettings& settings);
+
+            /*
+            Transit-native engine (RAPTOR): works on the bus stop sequences directly,
+            one round per boarding, so the quadratic span edges are never built.
+            */
+            class RoutePatternRouter {
+            public:
+                RoutePatternRouter(const Database& source, const domain::RouterSettings& settings);
+                std::optional<RoutePlan> BuildRoute(std::string_view from, std::string_view to) const;
+                //stops in the order of the catalogue, not sorted
+                std::optional<Isochrone> BuildIsochrone(std::string_view from, Time max_time) const;
+
+            private:
+                //one direction of a bus: its stops in order and the ride time from the first one
+                struct Pattern {
+                    std::string_view busname;
+                    std::vector<size_t> stops;
+                    std::vector<Time> ride_times;
+                };
+
+                struct PatternStop {
+                    size_t pattern;
+                    size_t position;
+                };
+
+                //how a stop was reached in a round: a ride on pattern between two positions
+                struct Label {
+                    size_t pattern;
+                    size_t board_position;
+                    size_t alight_position;
+                };
+
+                struct Rounds {
+                    std::vector<std::optional<Time>> best_arrivals;
+                    //[round][stop]
+                    std::vector<std::vector<std::optional<Label>>> labels;
+                };
+
+                //arrivals later than max_time, or not earlier than the best one at the target, are dropped
+                Rounds RunRounds(size_t source, std::optional<size_t> target, Time max_time) const;
+                template <typename Iter>
+                void AddPattern(std::string_view busname, Iter first, Iter last, const Database& source, Time minutes_per_meter);
+
+                std::vector<Stop> stops_;
+                std::unordered_map<std::string_view, size_t> stopname_to_index_;
+                std::vector<Pattern> patterns_;
+                std::vector<std::vector<PatternStop>> stop_to_patterns_;
+                Time bus_wait_time_;
+            };
 
             class TransportGraphFactory {
             public:
@@ -54,11 +245,144 @@ namespace catalogue {
                 дайте мне знать, и я изменю его.
                 */
                 Graph MakeTransportGraph() {
-                    Graph graph(database_.GetActiveStops());
-                    MakeBusesEdges(graph);
+                    Graph graph(database_.GetActiveStops(), settings_.single_vertex_per_stop 
+                                                            ? std::optional<Time>(settings_.bus_wait_time) : std::nullopt);
+                    std::vector<PendingEdge> edges;
+                    const auto patterns = GroupBusPatterns();
+                    MakeBusesEdges(graph, patterns, edges);
+                    for (size_t index = 0; index < edges.size(); index++) {
+                        if (edges[index].path.span_count > 0) {
+                            bus_edges_[edges[index].path.path_name].push_back(index);
+                        }
+                    }
+                    size_t shared_edge_count = 0;
+                    for (const auto& pattern : patterns) {
+                        const auto& edge_ids = bus_edges_[pattern.bus -> name];
+                        for (const std::string_view busname : pattern.busnames) {
+                            if (busname != pattern.bus -> name) {
+                                bus_edges_[busname] = edge_ids;
+                                shared_edge_count += CountBusEdges(*pattern.bus, graph);
+                            }
+                        }
+                    }
+                    if (settings_.prune_dominated_edges) {
+                        const auto survivor_indexes = PruneDominatedEdges(edges);
+                        //the edges a bus shares would have been dropped as parallel ones
+                        pruned_edge_count_ += shared_edge_count;
+                        for (auto& [busname, edge_ids] : bus_edges_) {
+                            for (auto& edge_id : edge_ids) {
+                                edge_id = survivor_indexes[edge_id];
+                            }
+                        }
+                    }
+                    for (auto& [edge, path] : edges) {
+                        graph.SetEdgePath(graph.AddEdge(edge), path);
+                    }
                     return graph;
                 }
 
+                //edges dropped by the last MakeTransportGraph or AddBusEdges call
+                size_t GetPrunedEdgeCount() const {
+                    return pruned_edge_count_;
+                }
+
+                //ride edges of every bus of the last MakeTransportGraph call
+                BusEdges ReleaseBusEdges() {
+                    return std::move(bus_edges_);
+                }
+
+                /*
+                Re-weights the rides of the buses passing the segment in either direction
+                (the distance is symmetric unless both directions are given). With pruning,
+                the pairs whose survivor may change are elected again among all the buses
+                serving their first stop. Returns the edges whose weight changed.
+                */
+                std::vector<graph::EdgeId> UpdateSegmentEdges(Graph& graph, const BusEdges& bus_edges, 
+                                                              std::string_view from, std::string_view to) {
+                    std::vector<graph::EdgeId> changed_edges;
+                    std::vector<graph::EdgeId> contested_edges;
+                    const auto stop_stats = database_.GetStopStats(from);
+                    if (!stop_stats.routes) {
+                        return changed_edges;
+                    }
+
+                    for (const auto& bus : *stop_stats.routes) {
+                        if (!PassesSegment(*bus, from, to)) {
+                            continue;
+                        }
+                        std::vector<PendingEdge> edges;
+                        MakeBusEdges(bus, graph, edges);
+                        const auto& edge_ids = bus_edges.at(bus -> name);
+                        size_t ride = 0;
+                        for (const auto& pending : edges) {
+                            if (pending.path.span_count == 0) {
+                                continue;
+                            }
+                            const graph::EdgeId edge_id = edge_ids[ride++];
+                            const PendingEdge current{graph.GetEdge(edge_id), graph.GetEdgePath(edge_id)};
+                            if (!settings_.prune_dominated_edges) {
+                                if (pending.edge.weight != current.edge.weight) {
+                                    graph.SetEdgeWeight(edge_id, pending.edge.weight);
+                                    changed_edges.push_back(edge_id);
+                                }
+                            } else if (current.path.path_name == bus -> name || Dominates(pending, current)) {
+                                contested_edges.push_back(edge_id);
+                            }
+                        }
+                    }
+
+                    if (!contested_edges.empty()) {
+                        ElectSurvivors(graph, std::move(contested_edges), changed_edges);
+                    }
+                    return changed_edges;
+                }
+
+                /*
+                Adds the edges of a bus whose stops all have vertexes, returns the new and the re-weighted edges.
+                A bus of the same stops as one in the graph shares its edges: with pruning they are
+                elected as usual (and renamed on a tie), without it they are renamed directly.
+                */
+                std::vector<graph::EdgeId> AddBusEdges(Graph& graph, BusEdges& bus_edges, const domain::RoutePtr& bus) {
+                    std::vector<graph::EdgeId> changed_edges;
+                    pruned_edge_count_ = 0;
+                    if (const auto pattern_bus = FindPatternBus(*bus, bus_edges); pattern_bus && !settings_.prune_dominated_edges) {
+                        bus_edges[bus -> name] = bus_edges.at(pattern_bus -> name);
+                        if (bus -> name < pattern_bus -> name) {
+                            RenameBusEdges(graph, bus_edges.at(bus -> name), *bus, pattern_bus -> name);
+                        }
+                        return changed_edges;
+                    }
+
+                    std::vector<PendingEdge> edges;
+                    MakeBusEdges(bus, graph, edges);
+                    auto& ride_edges = bus_edges[bus -> name];
+
+                    for (const auto& pending : edges) {
+                        std::optional<graph::EdgeId> edge_id;
+                        if (settings_.prune_dominated_edges) {
+                            edge_id = FindEdge(graph, pending.edge.from, pending.edge.to);
+                        }
+                        if (!edge_id) {
+                            edge_id = graph.AddEdge(pending.edge);
+                            graph.SetEdgePath(*edge_id, pending.path);
+                            changed_edges.push_back(*edge_id);
+                        } else {
+                            pruned_edge_count_++;
+                            if (Dominates(pending, {graph.GetEdge(*edge_id), graph.GetEdgePath(*edge_id)})) {
+                                graph.SetEdgePath(*edge_id, pending.path);
+                                if (pending.edge.weight != graph.GetEdge(*edge_id).weight) {
+                                    graph.SetEdgeWeight(*edge_id, pending.edge.weight);
+                                    changed_edges.push_back(*edge_id);
+                                }
+                            }
+                        }
+                        if (pending.path.span_count > 0) {
+                            ride_edges.push_back(*edge_id);
+                        }
+                    }
+                    return changed_edges;
+                }
+
             private:
                 template <typename Iter>
                 struct BusStopsData {
@@ -67,66 +391,357 @@ namespace catalogue {
                     Iter last;
                 };
 
+                //buses of the same stops in the same order (and of the same roundtrip flag), sharing their edges
+                struct BusPattern {
+                    //the bus of the smallest name, as the pruning would elect it, whose name the edges carry
+                    domain::RoutePtr bus;
+                    std::vector<std::string_view> busnames;
+                };
+
+                //edge waiting to be added to the graph, after the optional pruning
+                struct PendingEdge {
+                    graph::Edge<Time> edge;
+                    Graph::EdgePath path;
+                };
+
+                /*
+                The stops are resolved once into their vertexes and the road distances from the
+                first stop, so every ride is the difference of two prefix sums and the quadratic
+                loop does no lookups. The distances are whole meters and summed exactly, so
+                equal rides of different buses get bitwise equal weights.
+                */
                 template <typename Iter>
-                void MakeStopsEdges(BusStopsData<Iter> routedata, Graph& graph) {
-                    for (auto from_iter = routedata.first; from_iter != routedata.last; from_iter++) {
-                        assert(*from_iter);
+                void MakeStopsEdges(BusStopsData<Iter> routedata, const Graph& graph, std::vector<PendingEdge>& edges) {
+                    std::vector<graph::VertexId> portals;
+                    std::vector<std::int64_t> distances_from_first;
+                    for (auto iter = routedata.first; iter != routedata.last; iter++) {
+                        assert(*iter);
+                        auto portal = graph.GetVertexId((*iter) -> name);
+                        assert(portal);
+                        portals.push_back(*portal);
+                        distances_from_first.push_back(iter == routedata.first ? 0 
+                                                       : distances_from_first.back() + database_.GetDistance((*std::prev(iter)) -> name, (*iter) -> name));
+                    }
 
-                        int span_count = 0;
-                        double accumulated_weight = 0;
+                    const double meters_per_minute = settings_.bus_velocity * METERS_PER_KILOMETER / MINUTES_PER_HOUR;
+                    //a single vertex per stop means every ride starts with the wait
+                    const double boarding_weight = graph.GetFoldedWait().value_or(0);
+                    for (size_t from = 0; from < portals.size(); from++) {
                         //in the two-vertexes structure, the distance between vertex portal and hub is 1
-                        auto from_portal = graph.GetVertexId((*from_iter) -> name);
-                        assert(from_portal);
+                        const graph::VertexId from_hub = graph.GetHubVertexId(portals[from]);
+                        if (from_hub != portals[from]) {
+                            edges.push_back({{portals[from], from_hub, double(settings_.bus_wait_time)}, 
+                                             {routedata.busname, 0}});
+                        }
+                        for (size_t to = from + 1; to < portals.size(); to++) {
+                            const auto distance = static_cast<double>(distances_from_first[to] - distances_from_first[from]);
+                            edges.push_back({{from_hub, portals[to], boarding_weight + distance / meters_per_minute},
+                                             {routedata.busname, static_cast<int>(to - from)}});
+                        }
+                    }
+                }
 
-                        auto from_hub = *from_portal + 1;
-                        graph.SetEdgePath(graph.AddEdge({*from_portal, from_hub, double(settings_.bus_wait_time)}),
-                                        {routedata.busname, span_count});
+                void MakeBusEdges(const domain::RoutePtr& bus, const Graph& graph, std::vector<PendingEdge>& edges) {
+                    using Stops = std::vector<Stop>;
 
-                        auto prev_vertex = from_iter;
-                        for (auto to_iter = std::next(from_iter); to_iter != routedata.last; to_iter++) {
+                    if (bus) {
+                        const Stops& stops = bus -> stops;
+                        MakeStopsEdges<Stops::const_iterator>({bus -> name, stops.begin(), stops.end()}, graph, edges);
+                        if (!(bus -> is_roundtrip)) {
+                            MakeStopsEdges<Stops::const_reverse_iterator>({bus -> name, stops.rbegin(), stops.rend()}, graph, edges);
+                        }
+                    }
+                }
+
+                //the edges MakeBusEdges generates for the bus
+                static size_t CountBusEdges(const domain::Route& bus, const Graph& graph) {
+                    const size_t stop_count = bus.stops.size();
+                    const size_t wait_edge_count = graph.GetFoldedWait() ? 0 : stop_count;
+                    const size_t direction_edge_count = wait_edge_count + stop_count * (stop_count - 1) / 2;
+                    return bus.is_roundtrip ? direction_edge_count : 2 * direction_edge_count;
+                }
 
-                            assert(*to_iter);
-                            
-                            std::string_view to_vertex_name = (*to_iter) -> name;
-                            auto to_portal = graph.GetVertexId(to_vertex_name);
-                            assert(to_portal);
+                //buses of one pattern ride the same stop sequence in the same way
+                static bool HasSameStops(const domain::Route& lhs, const domain::Route& rhs) {
+                    return lhs.is_roundtrip == rhs.is_roundtrip && lhs.stops == rhs.stops;
+                }
 
-                            static const int METERS_PER_KILOMETER = 1000;
-                            static const int MINUTES_PER_HOUR = 60;
-                            
-                            graph.SetEdgePath(graph.AddEdge({from_hub, *to_portal, accumulated_weight += 
-                                                            (database_.GetDistance((*prev_vertex) -> name, to_vertex_name) / 
-                                                            (settings_.bus_velocity * METERS_PER_KILOMETER / MINUTES_PER_HOUR))}),
-                                                            {routedata.busname, ++span_count});
-                                                            
-                            prev_vertex = to_iter;       
+                //the patterns in the order of their first bus
+                std::vector<BusPattern> GroupBusPatterns() const {
+                    auto stops_less = [](const domain::Route* lhs, const domain::Route* rhs) {
+                        return std::tie(lhs -> is_roundtrip, lhs -> stops) < std::tie(rhs -> is_roundtrip, rhs -> stops);
+                    };
+                    std::map<const domain::Route*, size_t, decltype(stops_less)> bus_to_pattern(stops_less);
+                    std::vector<BusPattern> patterns;
+                    for (const auto& bus : database_.GetActiveRoutes()) {
+                        auto [iter, inserted] = bus_to_pattern.emplace(bus.get(), patterns.size());
+                        if (inserted) {
+                            patterns.push_back({bus, {bus -> name}});
+                            continue;
+                        }
+                        auto& pattern = patterns[iter -> second];
+                        pattern.busnames.push_back(bus -> name);
+                        if (bus -> name < pattern.bus -> name) {
+                            pattern.bus = bus;
                         }
                     }
+                    return patterns;
                 }
 
-                void MakeBusesEdges(Graph& graph) {
-                    for (const auto& bus : database_.GetActiveRoutes()) {
-                        using Stops = std::vector<Stop>;
+                //the bus whose name the edges of bus's pattern carry in the graph (bus is not in it yet), nullptr for a new pattern
+                domain::RoutePtr FindPatternBus(const domain::Route& bus, const BusEdges& bus_edges) const {
+                    domain::RoutePtr pattern_bus;
+                    const auto stop_stats = database_.GetStopStats(bus.stops.front() -> name);
+                    if (!stop_stats.routes) {
+                        return pattern_bus;
+                    }
+                    for (const auto& other : *stop_stats.routes) {
+                        if (other -> name == bus.name || !HasSameStops(*other, bus) || bus_edges.count(other -> name) == 0) {
+                            continue;
+                        }
+                        if (!pattern_bus || other -> name < pattern_bus -> name) {
+                            pattern_bus = other;
+                        }
+                    }
+                    return pattern_bus;
+                }
 
-                        if (bus) {
-                            const Stops& stops = bus -> stops;
-                            MakeStopsEdges<Stops::const_iterator>({bus -> name, stops.begin(), stops.end()}, graph);
-                            if (!(bus -> is_roundtrip)) {
-                                MakeStopsEdges<Stops::const_reverse_iterator>({bus -> name, stops.rbegin(), stops.rend()}, graph);
+                //moves the wait and ride edges of the bus's stops carrying the old name over to the bus
+                static void RenameBusEdges(Graph& graph, const std::vector<graph::EdgeId>& ride_edges, 
+                                           const domain::Route& bus, std::string_view old_name) {
+                    for (const auto& stop : bus.stops) {
+                        const graph::VertexId portal = *graph.GetVertexId(stop -> name);
+                        for (const auto edge_id : graph.GetIncidentEdges(portal)) {
+                            const auto& path = graph.GetEdgePath(edge_id);
+                            if (path.span_count == 0 && path.path_name == old_name) {
+                                graph.SetEdgePath(edge_id, {bus.name, 0});
                             }
                         }
                     }
+                    for (const auto edge_id : ride_edges) {
+                        if (const auto& path = graph.GetEdgePath(edge_id); path.path_name == old_name) {
+                            graph.SetEdgePath(edge_id, {bus.name, path.span_count});
+                        }
+                    }
                 }
 
+                /*
+                Only the first bus of every pattern generates edges. Every worker generates the edges
+                of a contiguous range of these buses into a buffer of its own, the ranges are balanced
+                by the edge counts (quadratic in the stop count) rather than by the number of buses.
+                The buffers are moved to the offsets given by the prefix sums of their sizes, so the
+                edges keep the order of the serial build.
+                */
+                void MakeBusesEdges(const Graph& graph, const std::vector<BusPattern>& patterns, std::vector<PendingEdge>& edges) {
+                    std::vector<domain::RoutePtr> buses;
+                    buses.reserve(patterns.size());
+                    for (const auto& pattern : patterns) {
+                        buses.push_back(pattern.bus);
+                    }
+                    const size_t worker_count = std::max<size_t>(1, std::min(parallel::ResolveWorkerCount(settings_.build_threads), 
+                                                                             buses.size()));
+                    std::vector<size_t> edge_counts_before(buses.size() + 1, 0);
+                    for (size_t index = 0; index < buses.size(); index++) {
+                        edge_counts_before[index + 1] = edge_counts_before[index] + CountBusEdges(*buses[index], graph);
+                    }
+                    if (worker_count == 1) {
+                        edges.reserve(edges.size() + edge_counts_before.back());
+                        for (const auto& bus : buses) {
+                            MakeBusEdges(bus, graph, edges);
+                        }
+                        return;
+                    }
+
+                    std::vector<size_t> first_buses(worker_count + 1, buses.size());
+                    for (size_t worker = 0, bus = 0; worker < worker_count; worker++) {
+                        while (bus < buses.size() && edge_counts_before[bus] * worker_count < edge_counts_before.back() * worker) {
+                            bus++;
+                        }
+                        first_buses[worker] = bus;
+                    }
+
+                    std::vector<std::vector<PendingEdge>> worker_edges(worker_count);
+                    parallel::ForEachWorker(worker_count, [&](size_t worker, size_t) {
+                        auto& local_edges = worker_edges[worker];
+                        local_edges.reserve(edge_counts_before[first_buses[worker + 1]] - edge_counts_before[first_buses[worker]]);
+                        for (size_t bus = first_buses[worker]; bus < first_buses[worker + 1]; bus++) {
+                            MakeBusEdges(buses[bus], graph, local_edges);
+                        }
+                    });
+
+                    std::vector<size_t> offsets(worker_count + 1, edges.size());
+                    for (size_t worker = 0; worker < worker_count; worker++) {
+                        offsets[worker + 1] = offsets[worker] + worker_edges[worker].size();
+                    }
+                    edges.resize(offsets.back());
+                    parallel::ForEachWorker(worker_count, [&](size_t worker, size_t) {
+                        std::move(worker_edges[worker].begin(), worker_edges[worker].end(), edges.begin() + offsets[worker]);
+                    });
+                }
+
+                static bool PassesSegment(const domain::Route& bus, std::string_view from, std::string_view to) {
+                    for (size_t index = 1; index < bus.stops.size(); index++) {
+                        std::string_view prev_stop = bus.stops[index - 1] -> name;
+                        std::string_view stop = bus.stops[index] -> name;
+                        if ((prev_stop == from && stop == to) || (prev_stop == to && stop == from)) {
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                static std::optional<graph::EdgeId> FindEdge(const Graph& graph, graph::VertexId from, graph::VertexId to) {
+                    for (const auto& arc : graph.GetIncidentArcs(from)) {
+                        if (arc.vertex == to) {
+                            return arc.edge_id;
+                        }
+                    }
+                    return std::nullopt;
+                }
+
+                //the lightest edge, and among equally heavy ones the one of the smallest bus name
+                static bool Dominates(const PendingEdge& lhs, const PendingEdge& rhs) {
+                    return lhs.edge.weight < rhs.edge.weight 
+                        || (lhs.edge.weight == rhs.edge.weight && lhs.path.path_name < rhs.path.path_name);
+                }
+
+                /*
+                Picks the survivor of every contested pair the way PruneDominatedEdges would:
+                the ride edges of all the buses serving the pair's first stop are generated
+                (once per bus) and the dominant one for the pair wins.
+                */
+                void ElectSurvivors(Graph& graph, std::vector<graph::EdgeId> contested_edges, std::vector<graph::EdgeId>& changed_edges) {
+                    std::sort(contested_edges.begin(), contested_edges.end(), [&graph](graph::EdgeId lhs, graph::EdgeId rhs) {
+                        return std::make_pair(graph.GetEdge(lhs).from, lhs) < std::make_pair(graph.GetEdge(rhs).from, rhs);
+                    });
+                    contested_edges.erase(std::unique(contested_edges.begin(), contested_edges.end()), contested_edges.end());
+
+                    std::unordered_map<std::string_view, std::vector<PendingEdge>> bus_to_edges;
+                    for (auto first = contested_edges.begin(); first != contested_edges.end();) {
+                        const graph::VertexId from = graph.GetEdge(*first).from;
+                        auto last = std::find_if(first, contested_edges.end(), [&graph, from](graph::EdgeId edge_id) {
+                            return graph.GetEdge(edge_id).from != from;
+                        });
+
+                        std::unordered_map<graph::VertexId, std::optional<PendingEdge>> to_survivor;
+                        for (auto iter = first; iter != last; iter++) {
+                            to_survivor[graph.GetEdge(*iter).to];
+                        }
+                        const auto stop = graph.GetVertex(from);
+                        assert(stop);
+                        const auto stop_stats = database_.GetStopStats((*stop) -> name);
+                        assert(stop_stats.routes);
+                        for (const auto& bus : *stop_stats.routes) {
+                            auto [bus_iter, inserted] = bus_to_edges.try_emplace(bus -> name);
+                            if (inserted) {
+                                MakeBusEdges(bus, graph, bus_iter -> second);
+                            }
+                            for (const auto& pending : bus_iter -> second) {
+                                if (pending.edge.from != from || pending.path.span_count == 0) {
+                                    continue;
+                                }
+                                if (auto survivor_iter = to_survivor.find(pending.edge.to); survivor_iter != to_survivor.end()) {
+                                    auto& survivor = survivor_iter -> second;
+                                    if (!survivor || Dominates(pending, *survivor)) {
+                                        survivor = pending;
+                                    }
+                                }
+                            }
+                        }
+
+                        for (auto iter = first; iter != last; iter++) {
+                            const auto& survivor = to_survivor.at(graph.GetEdge(*iter).to);
+                            assert(survivor);
+                            graph.SetEdgePath(*iter, survivor -> path);
+                            if (survivor -> edge.weight != graph.GetEdge(*iter).weight) {
+                                graph.SetEdgeWeight(*iter, survivor -> edge.weight);
+                                changed_edges.push_back(*iter);
+                            }
+                        }
+                        first = last;
+                    }
+                }
+
+                /*
+                Keeps a single edge per (from, to) vertex pair: the lightest one, and among
+                equally heavy ones the one of the smallest bus name, so the answers do not
+                depend on the order the buses are visited in. The survivors keep their order.
+                Returns the index every edge's pair survivor ends up at.
+                */
+                std::vector<size_t> PruneDominatedEdges(std::vector<PendingEdge>& edges) {
+                    std::unordered_map<std::pair<graph::VertexId, graph::VertexId>, size_t, VertexPairHasher> pair_to_edge;
+                    pair_to_edge.reserve(edges.size());
+                    std::vector<const size_t*> survivors(edges.size());
+                    std::vector<bool> is_kept(edges.size(), false);
+                    for (size_t index = 0; index < edges.size(); index++) {
+                        const auto& edge = edges[index].edge;
+                        auto [iter, inserted] = pair_to_edge.emplace(std::make_pair(edge.from, edge.to), index);
+                        if (inserted) {
+                            is_kept[index] = true;
+                        } else if (Dominates(edges[index], edges[iter -> second])) {
+                            is_kept[iter -> second] = false;
+                            is_kept[index] = true;
+                            iter -> second = index;
+                        }
+                        survivors[index] = &(iter -> second);
+                    }
+
+                    std::vector<size_t> kept_indexes(edges.size());
+                    size_t kept_count = 0;
+                    for (size_t index = 0; index < edges.size(); index++) {
+                        if (is_kept[index]) {
+                            kept_indexes[index] = kept_count;
+                            edges[kept_count++] = std::move(edges[index]);
+                        }
+                    }
+                    pruned_edge_count_ = edges.size() - kept_count;
+                    edges.resize(kept_count);
+
+                    std::vector<size_t> survivor_indexes(survivors.size());
+                    for (size_t index = 0; index < survivors.size(); index++) {
+                        survivor_indexes[index] = kept_indexes[*survivors[index]];
+                    }
+                    return survivor_indexes;
+                }
+
+                struct VertexPairHasher {
+                    size_t operator()(const std::pair<graph::VertexId, graph::VertexId>& vertexes) const {
+                        return hasher_(vertexes.first) * N + hasher_(vertexes.second);
+                    }
+
+                private:
+                    std::hash<graph::VertexId> hasher_;
+                    //const num to be used for a higher accuracy to the hash production: a small one
+                    //(37 * from + to) makes the pairs of a few thousand vertexes collide by the dozen
+                    const size_t N = 0x9E3779B97F4A7C15ull;
+                };
+
             private:
                 const Database& database_;
                 const domain::RouterSettings& settings_;
+                size_t pruned_edge_count_ = 0;
+                BusEdges bus_edges_;
                 
             };
 
         private:
+            const Database& database_;
+            domain::RouterSettings settings_;
+            size_t pruned_edge_count_ = 0;
+            BusEdges bus_edges_;
+            std::uint64_t snapshot_fingerprint_ = 0;
+            //the mapped file router_ answers from in place, until the first update
+            std::unique_ptr<RouterSnapshot> snapshot_;
             Graph graph_;
-            Router router_;
+            size_t query_threads_;
+            std::unique_ptr<RouteBuilder> router_;
+            //router_ itself when it is the tree cache
+            const graph::ShortestPathTreeCache<Time>* tree_cache_ = nullptr;
+            //router_ itself when it is the all-pairs table
+            graph::Router<Time>* all_pairs_router_ = nullptr;
+            //router_ itself when it is the hub-label engine
+            const graph::HubLabelRouter<Time>* hub_label_router_ = nullptr;
+            std::unique_ptr<RoutePatternRouter> pattern_router_;
         };
     } //namespace router
 } //namespace catalogue 